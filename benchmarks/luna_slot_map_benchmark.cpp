@@ -0,0 +1,112 @@
+#include "luna-gfx/gfx.hpp"
+#include "luna-gfx/common/slot_map.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/vulkan/data_types.hpp"
+#include "luna-gfx/vulkan/pipeline.hpp"
+#include "luna-gfx/vulkan/descriptor.hpp"
+#include "luna-gfx/vulkan/render_pass.hpp"
+#include "luna-gfx/vulkan/swapchain.hpp"
+#include "luna-gfx/vulkan/window.hpp"
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+constexpr auto cGPU = 0;
+constexpr auto cNumIterations = 100000;
+constexpr auto cTableSize = 1024; // What every GlobalResources table used to be pre-sized to.
+constexpr auto cCmdTableSize = 64;
+constexpr auto cWindowTableSize = 10;
+constexpr auto cBufferSize = 256u;
+const auto cLiveCounts = std::vector<std::size_t>{0, 256, 512, 1000};
+
+using Clock = std::chrono::high_resolution_clock;
+using Millis = std::chrono::duration<double, std::milli>;
+
+// Stand-in for a GlobalResources entry (vulkan::Buffer reports validity the same way).
+struct Entry {
+  bool alive = false;
+  auto valid() const -> bool {return this->alive;}
+};
+
+// The allocator GlobalResources used before the slot map: scan the whole table for the first non-valid entry.
+template<typename T>
+auto find_valid_entry(const T& container) -> std::size_t {
+  auto index = 0u;
+  for(const auto& a : container) {
+    if(!a.valid()) {return index;}
+    index++;
+  }
+  return 0;
+}
+
+auto bench_linear_scan(std::size_t live) -> Millis {
+  auto table = std::vector<Entry>(cTableSize);
+  for(auto i = 0u; i < live; i++) table[find_valid_entry(table)].alive = true;
+
+  auto start = Clock::now();
+  for(auto i = 0; i < cNumIterations; i++) {
+    auto index = find_valid_entry(table);
+    table[index].alive = true;
+    table[index].alive = false;
+  }
+  return Clock::now() - start;
+}
+
+auto bench_slot_map(std::size_t live) -> Millis {
+  auto table = luna::gfx::SlotMap<Entry>(cTableSize);
+  for(auto i = 0u; i < live; i++) table[table.acquire()].alive = true;
+
+  auto start = Clock::now();
+  for(auto i = 0; i < cNumIterations; i++) {
+    auto handle = table.acquire();
+    table[handle].alive = true;
+    table[handle].alive = false;
+    table.release(handle);
+  }
+  return Clock::now() - start;
+}
+
+// Full create/destroy of gfx::MemoryBuffers, with `live` other buffers already alive.
+auto bench_buffers(std::size_t live) -> Millis {
+  auto scene = std::vector<luna::gfx::MemoryBuffer>();
+  scene.reserve(live);
+  for(auto i = 0u; i < live; i++) scene.emplace_back(cGPU, cBufferSize, luna::gfx::MemoryType::GPUOptimal);
+
+  auto start = Clock::now();
+  for(auto i = 0; i < cNumIterations; i++) {
+    auto buffer = luna::gfx::MemoryBuffer(cGPU, cBufferSize, luna::gfx::MemoryType::GPUOptimal);
+  }
+  return Clock::now() - start;
+}
+
+// Host memory the GlobalResources tables used to pre-construct at startup, before anything was created.
+auto legacy_startup_bytes(std::size_t num_gpus) -> std::size_t {
+  using namespace luna::vulkan;
+  auto per_object = sizeof(Buffer) + sizeof(Image) + sizeof(Pipeline) + sizeof(Descriptor) + sizeof(RenderPass);
+  return cTableSize * per_object + cCmdTableSize * sizeof(CommandBuffer) +
+         cWindowTableSize * (sizeof(Swapchain) + sizeof(Window)) + num_gpus * cTableSize * sizeof(Semaphore);
+}
+
+auto main() -> int {
+  auto& res = luna::vulkan::global_resources();
+  std::cout << "Startup object table memory:\n";
+  std::cout << "  fixed tables: " << legacy_startup_bytes(res.devices.size()) << " bytes | chunked tables: "
+            << res.memory_usage() << " bytes\n";
+
+  std::cout << "Acquire/release of " << cNumIterations << " handles:\n";
+  for(auto live : cLiveCounts) {
+    auto scan = bench_linear_scan(live);
+    auto slot = bench_slot_map(live);
+    std::cout << "  " << live << " live | linear scan: " << scan.count() << "ms | slot map: " << slot.count()
+              << "ms | speedup: " << scan.count() / slot.count() << "x\n";
+  }
+
+  std::cout << "Create/destroy of " << cNumIterations << " gfx::MemoryBuffers:\n";
+  for(auto live : cLiveCounts) {
+    auto time = bench_buffers(live);
+    std::cout << "  " << live << " live | " << time.count() << "ms | " << (time.count() * 1000.0) / cNumIterations << "us per buffer\n";
+  }
+  std::cout << "Object table memory after benchmarking: " << res.memory_usage() << " bytes\n";
+  return 0;
+}
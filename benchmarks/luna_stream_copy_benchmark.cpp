@@ -0,0 +1,50 @@
+#include "luna-gfx/gfx.hpp"
+#include "luna-gfx/common/streaming_copy.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+constexpr auto cGPU = 0;
+constexpr auto cMinSize = std::size_t(64) * 1024;
+constexpr auto cMaxSize = std::size_t(64) * 1024 * 1024;
+constexpr auto cBytesPerSize = std::size_t(1024) * 1024 * 1024; // Roughly how much gets copied for each payload size.
+
+using Clock = std::chrono::high_resolution_clock;
+using Seconds = std::chrono::duration<double>;
+
+auto iterations_for(std::size_t size) -> std::size_t {
+  return std::max<std::size_t>(1, cBytesPerSize / size);
+}
+
+template<typename Func>
+auto bench(std::size_t size, Func&& copy) -> double {
+  auto iterations = iterations_for(size);
+  auto start = Clock::now();
+  for(auto i = 0u; i < iterations; i++) copy();
+  auto time = Seconds(Clock::now() - start);
+  return (static_cast<double>(size * iterations) / (1024.0 * 1024.0 * 1024.0)) / time.count();
+}
+
+auto main() -> int {
+  using luna::gfx::CopyKernel;
+  auto data = std::vector<unsigned char>(cMaxSize, 0xAB);
+
+  // Staging memory is what uploads actually write into, and is usually write-combined.
+  auto buffer = luna::gfx::MemoryBuffer(cGPU, cMaxSize, luna::gfx::MemoryType::Staging);
+  unsigned char* mapped = nullptr;
+  buffer.map(&mapped);
+
+  std::cout << "Upload bandwidth into mapped staging memory (GB/s), best kernel: "
+            << static_cast<int>(luna::gfx::best_copy_kernel()) << "\n";
+  for(auto size = cMinSize; size <= cMaxSize; size *= 4) {
+    auto memcpy_rate = bench(size, [&]() {std::memcpy(mapped, data.data(), size);});
+    auto sse2_rate = bench(size, [&]() {luna::gfx::stream_copy(CopyKernel::SSE2, mapped, data.data(), size);});
+    auto avx2_rate = bench(size, [&]() {luna::gfx::stream_copy(CopyKernel::AVX2, mapped, data.data(), size);});
+    std::cout << "  " << size << " bytes | memcpy: " << memcpy_rate << " | sse2: " << sse2_rate
+              << " | avx2: " << avx2_rate << " | speedup: " << std::max(sse2_rate, avx2_rate) / memcpy_rate << "x\n";
+  }
+  return 0;
+}
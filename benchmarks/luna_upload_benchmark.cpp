@@ -0,0 +1,70 @@
+#include "luna-gfx/gfx.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/vulkan/data_types.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+constexpr auto cGPU = 0;
+constexpr auto cMinSize = std::size_t(64);
+constexpr auto cMaxSize = std::size_t(64) * 1024 * 1024;
+constexpr auto cBytesPerSize = std::size_t(256) * 1024 * 1024; // Roughly how much gets uploaded for each payload size.
+constexpr auto cMaxIterations = std::size_t(100000);
+
+using Clock = std::chrono::high_resolution_clock;
+using Seconds = std::chrono::duration<double>;
+
+auto iterations_for(std::size_t size) -> std::size_t {
+  return std::max<std::size_t>(1, std::min(cMaxIterations, cBytesPerSize / size));
+}
+
+// What MemoryBuffer::upload used to do for host-visible memory: map, copy, unmap on every call.
+auto bench_map_per_upload(luna::gfx::MemoryBuffer& buffer, const std::vector<unsigned char>& data, std::size_t size) -> Seconds {
+  auto& res = luna::vulkan::global_resources();
+  auto& buf = res.buffers[buffer.handle()];
+  auto alloc = res.allocators[buf.gpu];
+  auto iterations = iterations_for(size);
+
+  auto start = Clock::now();
+  for(auto i = 0u; i < iterations; i++) {
+    void* ptr = nullptr;
+    vmaMapMemory(alloc, buf.alloc, &ptr);
+    std::memcpy(ptr, data.data(), size);
+    vmaFlushAllocation(alloc, buf.alloc, 0, size);
+    vmaUnmapMemory(alloc, buf.alloc);
+  }
+  return Clock::now() - start;
+}
+
+// Uploading through the persistent mapping.
+auto bench_persistent(luna::gfx::MemoryBuffer& buffer, const std::vector<unsigned char>& data, std::size_t size) -> Seconds {
+  auto iterations = iterations_for(size);
+  auto start = Clock::now();
+  for(auto i = 0u; i < iterations; i++) {
+    buffer.upload(data.data(), size);
+  }
+  return Clock::now() - start;
+}
+
+auto throughput(std::size_t size, Seconds time) -> double {
+  auto bytes = static_cast<double>(size * iterations_for(size));
+  return (bytes / (1024.0 * 1024.0 * 1024.0)) / time.count();
+}
+
+auto main() -> int {
+  auto data = std::vector<unsigned char>(cMaxSize, 0xAB);
+  auto buffer = luna::gfx::MemoryBuffer(cGPU, cMaxSize, luna::gfx::MemoryType::CPUVisible);
+
+  std::cout << "Host-visible upload throughput (GB/s):\n";
+  for(auto size = cMinSize; size <= cMaxSize; size *= 4) {
+    auto before = bench_map_per_upload(buffer, data, size);
+    auto after = bench_persistent(buffer, data, size);
+    std::cout << "  " << size << " bytes | map per upload: " << throughput(size, before)
+              << " | persistent: " << throughput(size, after) << " | speedup: " << before.count() / after.count()
+              << "x\n";
+  }
+  return 0;
+}
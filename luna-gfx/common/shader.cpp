@@ -216,6 +216,7 @@ struct Shader::ShaderData {
       -> std::string;
   inline auto assemble(shaderc_shader_kind kind, std::string_view src,
                        bool optimize = false) -> std::vector<uint32_t>;
+  inline auto make_dynamic(const std::vector<std::string>& names) -> void;
 };
 
 Shader::ShaderData::ShaderData() {
@@ -231,6 +232,15 @@ auto Shader::ShaderData::reflect(Shader::Stage& stage) -> void {
 
   this->reflect_variables(stage, module);
   this->reflect_io(stage, module);
+
+  // Push constant blocks can start past zero when stages split the range, so it's the furthest end that counts.
+  auto count = 0u;
+  result = spvReflectEnumeratePushConstantBlocks(&module, &count, nullptr);
+  if(result != success) throw std::runtime_error("Failed to enumerate SPV.");
+  auto blocks = std::vector<SpvReflectBlockVariable*>(count);
+  result = spvReflectEnumeratePushConstantBlocks(&module, &count, blocks.data());
+  if(result != success) throw std::runtime_error("Failed to enumerate SPV.");
+  for(const auto* block : blocks) stage.push_constant_size = std::max<size_t>(stage.push_constant_size, block->offset + block->size);
   spvReflectDestroyShaderModule(&module);
   (void)result;
   (void)success;
@@ -311,6 +321,19 @@ auto Shader::ShaderData::reflect_variables(Shader::Stage& stage,
   (void)success;
   (void)result;
 }
+auto Shader::ShaderData::make_dynamic(const std::vector<std::string>& names) -> void {
+  // Reflection can't tell a dynamic buffer from a regular one, so the pipeline info has to.
+  for(auto& stage : this->stages) {
+    for(auto& name : names) {
+      auto iter = stage.variables.find(name);
+      if(iter == stage.variables.end()) continue;
+      auto& type = iter->second.type;
+      if(type == Stage::Variable::Type::Uniform) type = Stage::Variable::Type::UniformDynamic;
+      if(type == Stage::Variable::Type::Storage) type = Stage::Variable::Type::StorateDynamic;
+    }
+  }
+}
+
 auto Shader::ShaderData::preprocess(std::string_view name,
                                     shaderc_shader_kind kind,
                                     std::string_view src) -> std::string {
@@ -447,6 +470,8 @@ Shader::Shader(const GraphicsPipelineInfo& info, std::vector<std::string> includ
 
     std::visit( shader_handler, shader.data);
   }  
+
+  this->data->make_dynamic(info.dynamic_bindings);
 }
 
 Shader::Shader(const ComputePipelineInfo& info, std::vector<std::string> include_dirs) {
@@ -490,6 +515,7 @@ Shader::Shader(const ComputePipelineInfo& info, std::vector<std::string> include
     }
   };
   std::visit(shader_handler, shader.data);
+  this->data->make_dynamic(info.dynamic_bindings);
 }
 
 Shader::Shader(Shader&& mv) {
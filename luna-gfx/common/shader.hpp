@@ -75,6 +75,7 @@ class Shader {
     std::vector<uint32_t> spirv;
     std::vector<Attribute> in_attributes;
     std::vector<Attribute> out_attributes;
+    size_t push_constant_size = 0; // Bytes of push constants the stage reads, zero if it has none.
   };
 
   explicit Shader();
@@ -0,0 +1,183 @@
+#pragma once
+#include "luna-gfx/error/error.hpp"
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace luna {
+namespace gfx {
+/** Slot-map style storage for handle-addressed objects.
+ * Handles are packed into a non-negative int32_t:
+ *   [ 0 | generation (11 bits) | slot index (20 bits) ]
+ * Acquire and release are O(1) by way of a free list, and every release bumps the slot's generation so
+ * a stale handle to a recycled slot is caught instead of silently aliasing whatever lives there now. With 11 bits the
+ * generation wraps after 2048 releases of the same slot, so a handle kept across that many reuses aliases again.
+ *
+ * Objects live in fixed-size chunks that are only allocated once the free list runs dry. Chunks are never
+ * reallocated or moved, so references into the map stay valid for as long as the slot is alive.
+ *
+ * Acquire and release are safe to call from any thread. Lookups don't lock at all, since a handle can only be
+ * obtained once the chunk it points into has been published, and a slot's generation & liveness are one atomic.
+ * Moving a map is not thread-safe.
+ */
+template<typename T, std::size_t ChunkSize = 256, std::size_t MaxSlots = (std::size_t(1u) << 20)>
+class SlotMap {
+  public:
+    static constexpr auto cIndexBits = 20u;
+    static constexpr auto cGenerationBits = 11u; // Top bit is left clear so that handles are never negative.
+    static constexpr auto cIndexMask = (1u << cIndexBits) - 1u;
+    static constexpr auto cGenerationMask = (1u << cGenerationBits) - 1u;
+    static constexpr auto cMaxSlots = MaxSlots;
+    static constexpr auto cChunkSize = ChunkSize;
+    static constexpr auto cMaxChunks = MaxSlots / ChunkSize;
+    static_assert(MaxSlots <= (std::size_t(1u) << cIndexBits), "A handle can't address that many slots.");
+    static_assert(MaxSlots % ChunkSize == 0, "Max slots must be a multiple of the chunk size.");
+
+    SlotMap() = default;
+    explicit SlotMap(std::size_t capacity) {this->reserve(capacity);}
+    SlotMap(SlotMap&& mv) {*this = std::move(mv);}
+    SlotMap(const SlotMap& cpy) = delete;
+    ~SlotMap() = default;
+    auto operator=(const SlotMap& cpy) -> SlotMap& = delete;
+
+    auto operator=(SlotMap&& mv) -> SlotMap& {
+      this->m_chunks = std::move(mv.m_chunks);
+      this->m_num_chunks = mv.m_num_chunks.exchange(0);
+      this->m_free = std::move(mv.m_free);
+      this->m_live = mv.m_live.exchange(0);
+      return *this;
+    }
+
+    // Makes sure at least this many slots exist without having to grow on acquire. Never shrinks.
+    auto reserve(std::size_t capacity) -> void {
+      LunaAssert(capacity <= cMaxSlots, "Requested more slots than this map can address.");
+      auto lock = std::scoped_lock(this->m_lock);
+      while(this->capacity() < capacity) this->grow();
+    }
+
+    // Grabs a free slot and returns the handle to it, allocating a new chunk if every slot is in use.
+    [[nodiscard]] auto acquire() -> std::int32_t {
+      auto lock = std::scoped_lock(this->m_lock);
+      if(this->m_free.empty()) this->grow();
+      auto index = this->m_free.back();
+      this->m_free.pop_back();
+      auto& slot = this->slot(index);
+      auto state = slot.state.load(std::memory_order_relaxed);
+      slot.state.store(state | cLiveBit, std::memory_order_release);
+      this->m_live++;
+      return pack(index, state >> 1u);
+    }
+
+    // Returns a slot to the free list. Any outstanding handles to it become stale.
+    auto release(std::int32_t handle) -> void {
+      auto lock = std::scoped_lock(this->m_lock);
+      LunaAssert(this->valid(handle), "Attempting to release an invalid or stale handle.");
+      auto index = index_of(handle);
+      auto& slot = this->slot(index);
+      auto generation = ((slot.state.load(std::memory_order_relaxed) >> 1u) + 1u) & cGenerationMask;
+      slot.state.store(generation << 1u, std::memory_order_release);
+      this->m_free.push_back(index);
+      this->m_live--;
+    }
+
+    // Whether or not the handle points to a live slot of the same generation.
+    [[nodiscard]] auto valid(std::int32_t handle) const -> bool {
+      if(handle < 0) return false;
+      auto index = index_of(handle);
+      if(index >= this->capacity()) return false;
+      auto state = this->slot(index).state.load(std::memory_order_acquire);
+      return (state & cLiveBit) && (state >> 1u) == generation_of(handle);
+    }
+
+    auto operator[](std::int32_t handle) -> T& {
+      LunaAssert(this->valid(handle), "Accessing an invalid or stale handle.");
+      return this->at_index(index_of(handle));
+    }
+
+    auto operator[](std::int32_t handle) const -> const T& {
+      LunaAssert(this->valid(handle), "Accessing an invalid or stale handle.");
+      return this->at_index(index_of(handle));
+    }
+
+    // Raw access to a slot regardless of whether it is live. For objects that are recycled along with their slot.
+    auto at_index(std::size_t index) -> T& {return this->m_chunks[index / ChunkSize]->data[index % ChunkSize];}
+    auto at_index(std::size_t index) const -> const T& {return this->m_chunks[index / ChunkSize]->data[index % ChunkSize];}
+
+    // Calls func(handle, object) for every live slot.
+    template<typename Func>
+    auto for_each(Func&& func) -> void {
+      for(auto index = 0u; index < this->capacity(); index++) {
+        auto state = this->slot(index).state.load(std::memory_order_acquire);
+        if(state & cLiveBit) func(pack(index, state >> 1u), this->at_index(index));
+      }
+    }
+
+    [[nodiscard]] auto capacity() const -> std::size_t {return this->m_num_chunks.load(std::memory_order_acquire) * ChunkSize;}
+    [[nodiscard]] auto size() const -> std::size_t {return this->m_live;}
+    [[nodiscard]] auto empty() const -> bool {return this->m_live == 0;}
+
+    // Bytes of heap memory this map is currently holding on to.
+    [[nodiscard]] auto memory_usage() const -> std::size_t {
+      auto lock = std::scoped_lock(this->m_lock);
+      auto directory = this->m_chunks ? cMaxChunks * sizeof(std::unique_ptr<Chunk>) : 0u;
+      return directory + this->m_num_chunks * sizeof(Chunk) + this->m_free.capacity() * sizeof(std::uint32_t);
+    }
+
+    [[nodiscard]] static constexpr auto index_of(std::int32_t handle) -> std::uint32_t {
+      return static_cast<std::uint32_t>(handle) & cIndexMask;
+    }
+
+    [[nodiscard]] static constexpr auto generation_of(std::int32_t handle) -> std::uint32_t {
+      return (static_cast<std::uint32_t>(handle) >> cIndexBits) & cGenerationMask;
+    }
+
+  private:
+    // The generation shifted up one, with whether the slot is live in the low bit.
+    static constexpr auto cLiveBit = 1u;
+    struct Slot {
+      std::atomic<std::uint32_t> state = 0;
+    };
+
+    struct Chunk {
+      std::array<T, ChunkSize> data;
+      std::array<Slot, ChunkSize> slots;
+    };
+
+    static constexpr auto pack(std::uint32_t index, std::uint32_t generation) -> std::int32_t {
+      return static_cast<std::int32_t>((generation << cIndexBits) | index);
+    }
+
+    auto slot(std::size_t index) -> Slot& {return this->m_chunks[index / ChunkSize]->slots[index % ChunkSize];}
+    auto slot(std::size_t index) const -> const Slot& {return this->m_chunks[index / ChunkSize]->slots[index % ChunkSize];}
+
+    // Must be called with the lock held.
+    auto grow() -> void {
+      LunaAssert(this->m_num_chunks < cMaxChunks, "Ran out of space!");
+
+      // The chunk directory is sized once up front so that it never has to move either.
+      if(!this->m_chunks) this->m_chunks = std::make_unique<std::unique_ptr<Chunk>[]>(cMaxChunks);
+      this->m_chunks[this->m_num_chunks] = std::make_unique<Chunk>();
+
+      // Publishing the new chunk count is what makes the chunk visible to lock-free lookups.
+      auto begin = this->m_num_chunks * ChunkSize;
+      this->m_num_chunks.fetch_add(1, std::memory_order_release);
+
+      // Push in reverse so that the lowest indices are handed out first.
+      this->m_free.reserve(this->m_free.size() + ChunkSize);
+      for(auto index = begin + ChunkSize; index > begin; index--) {
+        this->m_free.push_back(static_cast<std::uint32_t>(index - 1));
+      }
+    }
+
+    std::unique_ptr<std::unique_ptr<Chunk>[]> m_chunks;
+    std::atomic<std::size_t> m_num_chunks = 0;
+    std::vector<std::uint32_t> m_free;
+    std::atomic<std::size_t> m_live = 0;
+    mutable std::mutex m_lock;
+};
+}
+}
@@ -0,0 +1,112 @@
+#include "luna-gfx/common/streaming_copy.hpp"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define LUNA_STREAM_SSE2 1
+#if defined(__GNUC__) || defined(__clang__)
+#define LUNA_STREAM_AVX2 1
+#define LUNA_TARGET_AVX2 __attribute__((target("avx2")))
+#elif defined(__AVX2__)
+#define LUNA_STREAM_AVX2 1
+#define LUNA_TARGET_AVX2
+#endif
+#endif
+
+namespace luna {
+namespace gfx {
+// Below this, the fence & alignment work costs more than skipping the cache saves.
+constexpr auto cStreamThreshold = std::size_t(4096);
+
+// Copies up to dst's next `align` byte boundary, so every store after it is aligned.
+inline auto align_head(unsigned char*& dst, const unsigned char*& src, std::size_t& size, std::size_t align) -> void {
+  auto head = (align - (reinterpret_cast<std::uintptr_t>(dst) & (align - 1))) & (align - 1);
+  if(head > size) head = size;
+  std::memcpy(dst, src, head);
+  dst += head;
+  src += head;
+  size -= head;
+}
+
+#ifdef LUNA_STREAM_SSE2
+inline auto copy_sse2(unsigned char* dst, const unsigned char* src, std::size_t size) -> void {
+  align_head(dst, src, size, 16);
+  for(; size >= 64; size -= 64, dst += 64, src += 64) {
+    auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+    auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+    auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 48));
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst), a);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 16), b);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 32), c);
+    _mm_stream_si128(reinterpret_cast<__m128i*>(dst + 48), d);
+  }
+  _mm_sfence();
+  std::memcpy(dst, src, size);
+}
+#endif
+
+#ifdef LUNA_STREAM_AVX2
+LUNA_TARGET_AVX2 inline auto copy_avx2(unsigned char* dst, const unsigned char* src, std::size_t size) -> void {
+  align_head(dst, src, size, 32);
+  for(; size >= 128; size -= 128, dst += 128, src += 128) {
+    auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+    auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+    auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 64));
+    auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 96));
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dst), a);
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 32), b);
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 64), c);
+    _mm256_stream_si256(reinterpret_cast<__m256i*>(dst + 96), d);
+  }
+  _mm_sfence();
+  _mm256_zeroupper();
+  std::memcpy(dst, src, size);
+}
+#endif
+
+inline auto supports_avx2() -> bool {
+#if defined(LUNA_STREAM_AVX2) && (defined(__GNUC__) || defined(__clang__))
+  return __builtin_cpu_supports("avx2");
+#elif defined(LUNA_STREAM_AVX2)
+  return true; // Only built in when the compiler already targets AVX2.
+#else
+  return false;
+#endif
+}
+
+auto best_copy_kernel() -> CopyKernel {
+  static const auto kernel = supports_avx2() ? CopyKernel::AVX2 :
+#ifdef LUNA_STREAM_SSE2
+                                               CopyKernel::SSE2;
+#else
+                                               CopyKernel::Scalar;
+#endif
+  return kernel;
+}
+
+auto stream_copy(void* dst, const void* src, std::size_t size) -> void {
+  if(size < cStreamThreshold) {
+    std::memcpy(dst, src, size);
+    return;
+  }
+  stream_copy(best_copy_kernel(), dst, src, size);
+}
+
+auto stream_copy(CopyKernel kernel, void* dst, const void* src, std::size_t size) -> void {
+  auto* out = static_cast<unsigned char*>(dst);
+  auto* in = static_cast<const unsigned char*>(src);
+  switch(kernel) {
+#ifdef LUNA_STREAM_AVX2
+    case CopyKernel::AVX2 : if(supports_avx2()) return copy_avx2(out, in, size); break;
+#endif
+#ifdef LUNA_STREAM_SSE2
+    case CopyKernel::SSE2 : return copy_sse2(out, in, size);
+#endif
+    default : break;
+  }
+  std::memcpy(dst, src, size);
+}
+}
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+
+namespace luna {
+namespace gfx {
+enum class CopyKernel {
+  Scalar, // Plain memcpy.
+  SSE2,   // 16 byte non-temporal stores.
+  AVX2,   // 32 byte non-temporal stores.
+};
+
+// The fastest kernel the running CPU supports.
+auto best_copy_kernel() -> CopyKernel;
+
+/** Copies into memory the CPU won't read back, like mapped GPU buffers.
+ * Large copies use non-temporal stores, which skip the cache & fill whole write-combining lines at a time instead of
+ * evicting everything else the CPU had cached. Small copies just memcpy. Every store is fenced before returning, so
+ * flushing or submitting right after is safe.
+ */
+auto stream_copy(void* dst, const void* src, std::size_t size) -> void;
+
+// Copies with a specific kernel, falling back to Scalar if the CPU doesn't support it. Mostly for benchmarking.
+auto stream_copy(CopyKernel kernel, void* dst, const void* src, std::size_t size) -> void;
+}
+}
@@ -23,16 +23,16 @@ public:
       this->m_pipelines[info.first] = std::move(GraphicsPipeline(this->m_pass, info.second));
     }
     this->m_info = info;
-    this->m_lists = gfx::MultiBuffered<gfx::CommandList>(info.render_pass_info.gpu);
+    this->m_commands = gfx::FrameCommands(info.render_pass_info.gpu);
   }
 
   Renderer(Renderer&& mv) = default;
   ~Renderer() = default;
   [[nodiscard]] auto info() {return this->m_info;}
+  // The command list for the next frame. Only valid until next() is called as many times as there are frames in flight.
   [[nodiscard]] auto next() -> CommandList& {
-    auto& tmp = *this->m_lists;
-    this->m_lists.advance();
-    return tmp;
+    this->m_commands.next_frame();
+    return this->m_commands.next();
   }
 
   [[nodiscard]] inline auto pass() const -> const RenderPass& {return this->m_pass;}
@@ -40,7 +40,7 @@ public:
   auto operator=(Renderer&& mv) -> Renderer& = default;
 private:
   RendererInfo m_info;
-  MultiBuffered<CommandList> m_lists;
+  FrameCommands m_commands;
   RenderPass m_pass;
   std::map<std::string, GraphicsPipeline> m_pipelines;
 };
@@ -7,4 +7,8 @@
 #include "luna-gfx/interface/pipeline.hpp"
 #include "luna-gfx/interface/bind_group.hpp"
 #include "luna-gfx/interface/command_list.hpp"
-#include "luna-gfx/interface/event.hpp"
\ No newline at end of file
+#include "luna-gfx/interface/event.hpp"
+#include "luna-gfx/interface/transient_ring.hpp"
+#include "luna-gfx/interface/frame_commands.hpp"
+#include "luna-gfx/interface/upload_queue.hpp"
+#include "luna-gfx/interface/readback_queue.hpp"
\ No newline at end of file
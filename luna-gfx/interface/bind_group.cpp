@@ -1,36 +1,55 @@
 #include "luna-gfx/interface/bind_group.hpp"
 #include "luna-gfx/interface/buffer.hpp"
 #include "luna-gfx/interface/image.hpp"
+#include "luna-gfx/interface/transient_ring.hpp"
 #include "luna-gfx/vulkan/descriptor.hpp"
 #include "luna-gfx/vulkan/global_resources.hpp"
+#include <mutex>
 namespace luna {
 namespace gfx {
 BindGroup::~BindGroup() {
   if(this->m_handle < 0) return;
   auto& res = vulkan::global_resources();
+  auto lock = std::scoped_lock(res.descriptor_lock);
   auto& desc = res.descriptors[this->m_handle];
   desc = std::move(vulkan::Descriptor());
+  res.descriptors.release(this->m_handle);
+  this->m_handle = -1;
 }
 
 auto BindGroup::set(const MemoryBuffer& buffer, std::string_view str) -> bool {
   auto& res = vulkan::global_resources();
-  auto& buf = res.buffers[buffer.handle()];
+  auto lock = std::scoped_lock(res.descriptor_lock);
   auto& desc = res.descriptors[this->m_handle];
-  return desc.bind(str, buf);
+  return desc.bind_buffer(str, buffer.handle());
+}
+
+auto BindGroup::set(const BufferRange& range, std::string_view str) -> bool {
+  auto& res = vulkan::global_resources();
+  auto lock = std::scoped_lock(res.descriptor_lock);
+  auto& desc = res.descriptors[this->m_handle];
+  return desc.bind_buffer(str, range.handle(), range.offset(), range.size());
 }
 
 auto BindGroup::set(const Image& image, std::string_view str) -> bool {
   auto& res = vulkan::global_resources();
-  auto& img = res.images[image.handle()];
+  auto lock = std::scoped_lock(res.descriptor_lock);
   auto& desc = res.descriptors[this->m_handle];
-  return desc.bind(str, img);
+  return desc.bind_image(str, image.handle());
 }
 
 auto BindGroup::set(const ImageView& image, std::string_view str) -> bool {
   auto& res = vulkan::global_resources();
-  auto& img = res.images[image.handle()];
+  auto lock = std::scoped_lock(res.descriptor_lock);
+  auto& desc = res.descriptors[this->m_handle];
+  return desc.bind_image(str, image.handle());
+}
+
+auto BindGroup::set(const TransientRing& ring, std::string_view str, std::size_t range) -> bool {
+  auto& res = vulkan::global_resources();
+  auto lock = std::scoped_lock(res.descriptor_lock);
   auto& desc = res.descriptors[this->m_handle];
-  return desc.bind(str, img);
+  return desc.bind_buffer(str, ring.buffer().handle(), 0, range);
 }
 }
 }
\ No newline at end of file
@@ -11,6 +11,7 @@ class ComputePipeline;
 class MemoryBuffer;
 class Image;
 class ImageView;
+class TransientRing;
 class BindGroup {
   public:
     BindGroup(const BindGroup& cpy) = delete;
@@ -25,6 +26,14 @@ class BindGroup {
     auto set(const MemoryBuffer& buffer, std::string_view str) -> bool;
     auto set(const Image& image, std::string_view str) -> bool;
     auto set(const ImageView& image, std::string_view str) -> bool;
+
+    // Binds just part of a buffer. Offsets have to respect the device's min uniform/storage buffer offset alignment.
+    template<typename T>
+    auto set(const VectorSlice<T>& slice, std::string_view str) -> bool {return this->set(slice.range(), str);}
+    auto set(const BufferRange& range, std::string_view str) -> bool;
+
+    // Binds a dynamic binding to the ring. Each bind picks its slice with a dynamic offset, `range` bytes long.
+    auto set(const TransientRing& ring, std::string_view str, std::size_t range) -> bool;
     
     [[nodiscard]] inline auto handle() const -> std::int32_t {return this->m_handle;}
     auto operator=(BindGroup&& mv) -> BindGroup& {this->m_handle = mv.m_handle; mv.m_handle = -1; return *this;};
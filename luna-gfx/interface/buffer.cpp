@@ -2,52 +2,127 @@
 #include "luna-gfx/vulkan/global_resources.hpp"
 #include "luna-gfx/vulkan/utils/helper_functions.hpp"
 #include "luna-gfx/vulkan/data_types.hpp"
+#include "luna-gfx/common/streaming_copy.hpp"
 #include "luna-gfx/error/error.hpp"
+#include <algorithm>
+#include <cstring>
 namespace luna {
 namespace gfx {
+// Only what each type is for, so the driver doesn't have to place every buffer somewhere that suits every use.
 inline auto usage_from_type(MemoryType type) {
   using bits = vk::BufferUsageFlagBits;
   auto usage_flags = vk::BufferUsageFlags();
+
+  // Every type can be copied both ways, which growing & defragmenting rely on. Staging & readback buffers get only that.
   usage_flags |= bits::eTransferDst | bits::eTransferSrc;
   switch(type) {
-    case MemoryType::Vertex : usage_flags |= bits::eVertexBuffer | bits::eStorageBuffer | bits::eUniformBuffer; break;
-    case MemoryType::Index : usage_flags |= bits::eIndexBuffer | bits::eStorageBuffer | bits::eUniformBuffer; break;
+    case MemoryType::Vertex : usage_flags |= bits::eVertexBuffer | bits::eStorageBuffer; break;
+    case MemoryType::Index : usage_flags |= bits::eIndexBuffer | bits::eStorageBuffer; break;
+    case MemoryType::Uniform : usage_flags |= bits::eUniformBuffer; break;
+    case MemoryType::Storage : usage_flags |= bits::eStorageBuffer; break;
+    case MemoryType::Indirect : usage_flags |= bits::eIndirectBuffer | bits::eStorageBuffer; break;
     case MemoryType::General : 
-    case MemoryType::CPUVisible : usage_flags |= bits::eVertexBuffer | bits::eIndexBuffer | bits::eStorageBuffer | bits::eUniformBuffer; break;
+    case MemoryType::CPUVisible : 
+    case MemoryType::Streaming : 
+    case MemoryType::DeviceLocalHostVisible : usage_flags |= bits::eVertexBuffer | bits::eIndexBuffer | bits::eStorageBuffer | bits::eUniformBuffer; break;
     default : break;
   }
 
   return usage_flags;
 }
 
-inline auto is_mappable(MemoryType type) -> bool {
+inline auto host_access(MemoryType type) -> vulkan::HostAccess {
   switch(type) {
-    case MemoryType::CPUVisible : return true;
-    case MemoryType::General : return true;
-    default: return false;
+    case MemoryType::CPUVisible :
+    case MemoryType::General :
+    case MemoryType::Readback : return vulkan::HostAccess::Random;
+    case MemoryType::Staging : return vulkan::HostAccess::SequentialWrite;
+    case MemoryType::Uniform :
+    case MemoryType::Streaming : return vulkan::HostAccess::Streaming;
+    case MemoryType::DeviceLocalHostVisible : return vulkan::HostAccess::DeviceSequentialWrite;
+    default: return vulkan::HostAccess::None;
+  }
+}
+
+// Non-temporal stores only pay off in write-combined memory. In cached memory they just make whatever reads it next miss.
+inline auto write_combined(MemoryType type) -> bool {
+  switch(host_access(type)) {
+    case vulkan::HostAccess::SequentialWrite :
+    case vulkan::HostAccess::Streaming :
+    case vulkan::HostAccess::DeviceSequentialWrite : return true;
+    default : return false;
   }
 }
 
+inline auto host_copy(MemoryType type, void* dst, const void* src, std::size_t size) -> void {
+  if(write_combined(type)) stream_copy(dst, src, size);
+  else std::memcpy(dst, src, size);
+}
+
 MemoryBuffer::MemoryBuffer(int gpu, std::size_t size, MemoryType type) {
-  auto index = luna::vulkan::create_buffer(gpu, size, usage_from_type(type), is_mappable(type));
+  auto index = luna::vulkan::create_buffer(gpu, size, usage_from_type(type), host_access(type), type);
   this->m_handle = index;
   this->m_type = type;
   this->m_size = size;
 }
 
+auto MemoryBuffer::operator=(MemoryBuffer&& mv) -> MemoryBuffer& {
+  if(this == &mv) return *this;
+  if(this->m_handle >= 0) {
+    auto handle = this->m_handle;
+    luna::vulkan::defer_destruction(this->gpu(), [handle]() {luna::vulkan::destroy_buffer(handle);});
+  }
+
+  this->m_handle = mv.m_handle;
+  this->m_type = mv.m_type;
+  this->m_size = mv.m_size;
+  mv.m_handle = -1;
+  mv.m_size = 0;
+  mv.m_type = MemoryType::Unknown;
+  return *this;
+}
+
 MemoryBuffer::~MemoryBuffer() {
   if(this->m_handle < 0) return; // Don't deconstruct an invalid handle!
-  luna::vulkan::destroy_buffer(this->m_handle);
+  auto handle = this->m_handle;
+  luna::vulkan::defer_destruction(this->gpu(), [handle]() {luna::vulkan::destroy_buffer(handle);});
   this->m_handle = -1;
   this->m_size = 0;
   this->m_type = MemoryType::Unknown;
 }
 
 auto MemoryBuffer::flush() -> void {
-  auto& res = luna::vulkan::global_resources();
-  auto& buffer = res.buffers[this->m_handle];
-  auto& alloc = res.allocators[buffer.gpu];
-  vmaFlushAllocation(alloc, buffer.alloc, 0, VK_WHOLE_SIZE);
+  luna::vulkan::flush_buffer(this->m_handle);
+}
+
+auto MemoryBuffer::flush(std::size_t offset, std::size_t size) -> void {
+  luna::vulkan::mark_buffer_dirty(this->m_handle, offset, size);
+  luna::vulkan::flush_buffer(this->m_handle);
+}
+
+auto MemoryBuffer::device_address() const -> std::uint64_t {
+  LunaAssert(this->m_handle >= 0, "Attempting to get the address of an invalid buffer.");
+  return luna::vulkan::buffer_device_address(this->m_handle);
+}
+
+BufferRange::BufferRange(const MemoryBuffer& buffer, std::size_t offset, std::size_t size) {
+  LunaAssert(offset <= buffer.size() && size <= buffer.size() - offset, "Attempting to make a range past the end of a buffer.");
+  this->m_handle = buffer.handle();
+  this->m_offset = offset;
+  this->m_size = size;
+}
+
+auto BufferRange::device_address() const -> std::uint64_t {
+  LunaAssert(this->m_handle >= 0, "Attempting to get the address of an invalid buffer.");
+  return luna::vulkan::buffer_device_address(this->m_handle) + this->m_offset;
+}
+
+auto MemoryBuffer::mappable() const -> bool {
+  return vulkan::global_resources().buffers[this->m_handle].mapped;
+}
+
+auto MemoryBuffer::coherent() const -> bool {
+  return vulkan::global_resources().buffers[this->m_handle].coherent;
 }
 
 auto MemoryBuffer::gpu() const -> int {
@@ -56,40 +131,53 @@ auto MemoryBuffer::gpu() const -> int {
 }
 
 auto MemoryBuffer::unmap() -> void {
-  LunaAssert(is_mappable(this->m_type), "Attempting to unmap a buffer that is not mappable");
+  LunaAssert(this->mappable(), "Attempting to unmap a buffer that is not mappable");
   luna::vulkan::unmap_buffer(this->m_handle);
 }
 
-auto MemoryBuffer::map_impl(void** ptr) -> void {
-  LunaAssert(is_mappable(this->m_type), "Attempting to map a buffer that is not mappable");
-  luna::vulkan::map_buffer(this->m_handle, ptr);
+auto MemoryBuffer::map_impl(void** ptr, bool mark_dirty) -> void {
+  LunaAssert(this->mappable(), "Attempting to map a buffer that is not mappable");
+  luna::vulkan::map_buffer(this->m_handle, ptr, mark_dirty);
 }
 
-auto MemoryBuffer::upload_data_impl(const unsigned char* in_data, std::size_t num_bytes) -> void {
+auto MemoryBuffer::upload_data_impl(const unsigned char* in_data, std::size_t num_bytes, std::size_t offset) -> void {
+  if(num_bytes == 0) return;
+  LunaAssert(offset + num_bytes <= this->m_size, "Attempting to upload past the end of a buffer.");
   auto& buf = vulkan::global_resources().buffers[this->m_handle];
-  unsigned char* ptr = nullptr;
 
-  if(is_mappable(this->m_type)) {
-    this->map(&ptr);
-    std::memcpy(ptr, in_data, num_bytes);
-    this->unmap();
+  if(buf.mapped) {
+    host_copy(buf.type, static_cast<unsigned char*>(buf.mapped) + offset, in_data, num_bytes);
+    this->flush(offset, num_bytes);
   } else {
-    auto tmp_buffer = MemoryBuffer(buf.gpu, this->m_size, MemoryType::CPUVisible);
-    tmp_buffer.upload(in_data);
-
-    auto cmd = luna::vulkan::create_cmd(buf.gpu);
-    luna::vulkan::begin_command_buffer(cmd);
-    luna::vulkan::copy_buffer_to_buffer(cmd, tmp_buffer.handle(), this->handle(), num_bytes);
-    luna::vulkan::end_command_buffer(cmd);
-    luna::vulkan::submit_command_buffer(cmd);
-    luna::vulkan::synchronize_cmd(cmd);
-    luna::vulkan::destroy_cmd(cmd);
+    luna::vulkan::upload_staged(this->m_handle, in_data, num_bytes, offset);
   }
 }
 
+auto reallocate_buffer(MemoryBuffer& buffer, int gpu, std::size_t size, std::size_t keep, MemoryType type) -> void {
+  LunaAssert(gpu >= 0, "Attempting to grow a buffer that was never created on a gpu.");
+  auto next = MemoryBuffer(gpu, size, type);
+  keep = std::min(keep, buffer.size());
+  if(keep > 0) {
+    // Copying on the host would need to know when the GPU last wrote the old buffer. Ordering a copy after
+    // everything already submitted doesn't.
+    vulkan::record_staged(gpu, [&](std::int32_t cmd) {
+      vulkan::memory_barrier(cmd, vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead);
+      vulkan::copy_buffer_to_buffer(cmd, buffer.handle(), next.handle(), keep);
+    });
+  }
+
+  // The old buffer gets destroyed once anything still using it is done.
+  buffer = std::move(next);
+}
+
 void unmap_mapped_buffer(std::int32_t handle) {
   luna::vulkan::unmap_buffer(handle);
 }
 
+auto flush_mapped_ranges(std::int32_t handle, const std::vector<std::pair<std::size_t, std::size_t>>& ranges) -> void {
+  for(const auto& range : ranges) luna::vulkan::mark_buffer_dirty(handle, range.first, range.second - range.first);
+  luna::vulkan::flush_buffer(handle);
+}
+
 }
 }
\ No newline at end of file
@@ -1,6 +1,8 @@
 #pragma once
+#include <algorithm>
 #include <cstddef>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
 namespace luna {
@@ -11,13 +13,28 @@ class MappedBuffer;
 template<typename T>
 class Vector;
 
+template<typename T>
+class VectorSlice;
+
 class MemoryBuffer;
+class BufferRange;
+// What a buffer is used for & how the host touches it. Each type only gets the usage it needs, which lets the driver
+// put it in the best memory for that. Types the host writes are persistently mapped.
 enum class MemoryType {
-      Vertex,
-      Index,
-      GPUOptimal,
-      CPUVisible,
-      General,
+      Vertex,                 // Device local vertices, also writable from compute.
+      Index,                  // Device local indices, also writable from compute.
+      GPUOptimal,             // Device local, only ever copied to & from.
+      CPUVisible,             // Host cached, usable as anything. For data the host reads back or writes at random.
+      General,                // Same as CPUVisible.
+      Uniform,                // Uniform data the host writes sequentially, like per-frame constants. Same memory as Streaming.
+      Storage,                // Device local storage buffers.
+      Indirect,               // Device local draw & dispatch arguments, writable from compute.
+      Staging,                // Written sequentially by the host & only copied from.
+      Readback,               // Host cached & only copied into, for reading results back.
+      DeviceLocalHostVisible, // Written sequentially by the host straight into device local memory with ReBAR. Without it,
+                              // the buffer isn't mapped & uploads go through staging.
+      Streaming,              // Anything the host rewrites every frame. Always mapped, and in device local memory with ReBAR
+                              // so the GPU doesn't read it over the bus.
       Unknown,
 };
 
@@ -30,23 +47,36 @@ class MemoryBuffer {
     MemoryBuffer() {this->m_handle = -1; this->m_size = 0; this->m_type = MemoryType::Unknown;}
     MemoryBuffer(int gpu, std::size_t size, MemoryType type = MemoryType::General);
     ~MemoryBuffer();
-    MemoryBuffer(MemoryBuffer&& mv) {*this = std::move(mv);};
+    MemoryBuffer(MemoryBuffer&& mv) {this->m_handle = -1; *this = std::move(mv);};
     auto unmap() -> void;
+
+    // Makes host writes visible to the GPU. Only does any work if the memory isn't host coherent.
+    // flush() covers what upload(), map() & MappedBuffer recorded as written since the last flush. Writes made later
+    // through an old map() pointer need flushing by range.
     auto flush() -> void;
+    auto flush(std::size_t offset, std::size_t size) -> void;
     auto gpu() const -> int;
+    [[nodiscard]] auto coherent() const -> bool;
+
+    // Whether map() works. DeviceLocalHostVisible buffers only are on devices with ReBAR.
+    [[nodiscard]] auto mappable() const -> bool;
 
     [[nodiscard]] inline auto type() const {return this->m_type;}
     [[nodiscard]] inline auto size() const {return this->m_size;}
     [[nodiscard]] inline auto handle() const -> std::int32_t {return this->m_handle;}
+
+    // A view of `size` bytes of this buffer, starting `offset` bytes in.
+    [[nodiscard]] auto range(std::size_t offset, std::size_t size) const -> BufferRange;
+
+    // Where the buffer lives on the GPU, for shaders to reach it through a pointer instead of a binding. Needs
+    // GPUInfo::buffer_device_address. A buffer whose address has been taken is never moved by gfx::defragment.
+    [[nodiscard]] auto device_address() const -> std::uint64_t;
     
-    auto operator=(MemoryBuffer&& mv) -> MemoryBuffer& {
-      this->m_handle = mv.m_handle;
-      this->m_type = mv.m_type;
-      this->m_size = mv.m_size;
-      mv.m_handle = -1;
-      return *this;
-    }
+    // Destroys whatever buffer this held before.
+    auto operator=(MemoryBuffer&& mv) -> MemoryBuffer&;
 
+    // Host-visible buffers are persistently mapped, so this just returns the pointer. Unmapping flushes what was
+    // written, the mapping itself lives as long as the buffer.
     template<typename T>
     auto map(T** ptr) -> void {
       this->map_impl(reinterpret_cast<void**>(ptr)); // reinterpret_cast so we can get an opaque ptr to map to.
@@ -56,15 +86,22 @@ class MemoryBuffer {
     auto upload(const T* ptr, std::size_t amt) -> void {
       upload_data_impl(reinterpret_cast<const unsigned char*>(ptr), sizeof(T) * amt);
     }
+
+    // Uploads `amt` elements, starting `dst_offset` elements into this buffer. Only that range gets flushed.
+    template<typename T>
+    auto upload(const T* ptr, std::size_t amt, std::size_t dst_offset) -> void {
+      upload_data_impl(reinterpret_cast<const unsigned char*>(ptr), sizeof(T) * amt, sizeof(T) * dst_offset);
+    }
     
     // Helper function to return a container that is STL-like but points to the mapped buffer of this object.
     // Note: Only works if this buffer is mappable.
     template<typename T>
     auto get_mapped_container() -> MappedBuffer<T> {
       auto m = MappedBuffer<T>();
-      this->map(&m.begin_);
+      this->map_impl(reinterpret_cast<void**>(&m.begin_), false); // The container tracks its own writes.
       m.end_ = m.begin_ + (this->size() / sizeof(T));
       m.m_handle = this->m_handle;
+      m.m_track = !this->coherent();
       return m;
     }
 
@@ -73,82 +110,254 @@ class MemoryBuffer {
     auto upload(const T* ptr) -> void { upload_data_impl(reinterpret_cast<const unsigned char*>(ptr), this->size());}
 
   private:
-    auto map_impl(void** ptr) -> void;
-    auto upload_data_impl(const unsigned char* in_data, std::size_t num_bytes) -> void;
+    template<typename T>
+    friend class Vector;
+    auto map_impl(void** ptr, bool mark_dirty = true) -> void;
+    auto upload_data_impl(const unsigned char* in_data, std::size_t num_bytes, std::size_t offset = 0) -> void;
     std::int32_t m_handle;
     MemoryType m_type;
     std::size_t m_size;
 };
 
+// A const view into part of a buffer: `size` bytes, starting `offset` bytes in.
+// Lets many meshes or objects share one big buffer, while still being drawn, copied & bound individually.
+class BufferRange {
+public:
+  BufferRange() {this->m_handle = -1; this->m_offset = 0; this->m_size = 0;}
+  BufferRange(const MemoryBuffer& buffer) {this->m_handle = buffer.handle(); this->m_offset = 0; this->m_size = buffer.size();}
+  BufferRange(const MemoryBuffer& buffer, std::size_t offset, std::size_t size);
+  ~BufferRange() = default;
+  [[nodiscard]] auto handle() const -> std::int32_t {return this->m_handle;}
+  [[nodiscard]] auto offset() const -> std::size_t {return this->m_offset;}
+  [[nodiscard]] auto size() const -> std::size_t {return this->m_size;}
+
+  // The device address of the range's first byte.
+  [[nodiscard]] auto device_address() const -> std::uint64_t;
+private:
+  std::int32_t m_handle;
+  std::size_t m_offset;
+  std::size_t m_size;
+};
+
+inline auto MemoryBuffer::range(std::size_t offset, std::size_t size) const -> BufferRange {
+  return BufferRange(*this, offset, size);
+}
+
+// Swaps a buffer out for a new one of `size` bytes, keeping the first `keep` bytes of its contents. The copy is done on
+// the GPU after whatever it was already doing, so it picks up anything still being written into the old buffer.
+auto reallocate_buffer(MemoryBuffer& buffer, int gpu, std::size_t size, std::size_t keep, MemoryType type) -> void;
+
 // Typed GPU memory. Prioritize using this for all data.
+// Like std::vector, it can hold more memory than it has elements. Growing past its capacity at least doubles it,
+// keeping the old contents, so appending elements one at a time only allocates O(log n) times. Vectors that can't be
+// mapped hold what's appended on the host, and upload it all in one staged copy the next time the buffer is used.
+// A default constructed vector holds nothing until something is added, and then allocates General memory on GPU 0.
 template<typename T>
 class Vector {
 public:
   Vector() {};
   Vector(int gpu, std::size_t count, MemoryType type = MemoryType::General) {
-    this->m_data = std::move(MemoryBuffer(gpu, sizeof(T) * count, type));
+    this->m_gpu = gpu;
+    this->m_type = type;
+    this->m_count = count;
+    if(count > 0) this->m_data = std::move(MemoryBuffer(gpu, sizeof(T) * count, type));
   }
-  Vector(Vector&& mv) = default;
+  Vector(Vector&& mv) {*this = std::move(mv);}
   Vector(const Vector& cpy) = delete;
   ~Vector() = default;
   auto operator=(const Vector& cpy) -> Vector& = delete;
-  auto operator=(Vector&& mv) -> Vector& = default;
-  [[nodiscard]] inline auto size() const -> std::size_t {return this->m_data.size() / sizeof(T);}
-  [[nodiscard]] inline auto get_mapped_container() -> MappedBuffer<T> {return this->m_data.get_mapped_container<T>();}
+
+  // Leaves the moved from vector empty, but still on the same GPU & type, so it can be filled again.
+  auto operator=(Vector&& mv) -> Vector& {
+    if(this == &mv) return *this;
+    this->m_data = std::move(mv.m_data);
+    this->m_appended = std::move(mv.m_appended);
+    this->m_count = mv.m_count;
+    this->m_gpu = mv.m_gpu;
+    this->m_type = mv.m_type;
+    mv.m_count = 0;
+    mv.m_appended.clear();
+    return *this;
+  }
+  [[nodiscard]] inline auto size() const -> std::size_t {return this->m_count;}
+  [[nodiscard]] inline auto capacity() const -> std::size_t {return this->m_data.size() / sizeof(T);}
   [[nodiscard]] inline auto empty() const -> bool {return this->size() == 0;}
-  inline auto flush() -> void {this->m_data.flush();}
-  inline auto upload(const T* ptr, std::size_t amt) -> void {this->m_data.upload(ptr, amt);}
-  inline auto upload(const T* ptr) -> void {this->m_data.upload(ptr, this->size());}
-  inline auto upload(T data) -> void {this->m_data.upload(&data, &data);}
+  [[nodiscard]] inline auto get_mapped_container() -> MappedBuffer<T> {
+    auto m = this->m_data.get_mapped_container<T>();
+    m.end_ = m.begin_ + this->size();
+    return m;
+  }
+  inline auto flush() -> void {this->upload_appended(); this->m_data.flush();}
+  inline auto upload(const T* ptr, std::size_t amt) -> void {this->upload_appended(); this->m_data.upload(ptr, amt);}
+  inline auto upload(const T* ptr, std::size_t amt, std::size_t dst_offset) -> void {this->upload_appended(); this->m_data.upload(ptr, amt, dst_offset);}
+  inline auto upload(const T* ptr) -> void {this->upload_appended(); this->m_data.upload(ptr, this->size());}
+  inline auto upload(T data) -> void {this->upload_appended(); this->m_data.upload(&data, 1);}
   inline auto map(T** ptr) -> void {this->m_data.map(ptr);}
   inline auto unmap() -> void {this->m_data.unmap();}
-  inline auto type() const {return this->m_data.type();}
+  inline auto type() const {return this->m_type;}
+
+  // Makes room for at least `amt` elements without changing the size.
+  inline auto reserve(std::size_t amt) -> void {
+    if(amt > this->capacity()) this->reallocate(amt, this->type());
+  }
+
   inline auto resize(std::size_t new_amt) -> void {this->resize(new_amt, this->type());}
   inline auto resize(std::size_t new_amt, MemoryType new_type) -> void {
-    auto gpu = m_data.gpu();
-    this->m_data = std::move(MemoryBuffer(gpu, sizeof(T) * new_amt, new_type));
+    this->upload_appended();
+    if(new_type != this->type()) this->reallocate(std::max(new_amt, this->capacity()), new_type);
+    else if(new_amt > this->capacity()) this->reallocate(this->grown(new_amt), new_type);
+    this->m_count = new_amt;
+  }
+
+  inline auto push_back(const T& value) -> void {this->append(&value, 1);}
+
+  // Copies `amt` elements onto the end of this vector.
+  inline auto append(const T* ptr, std::size_t amt) -> void {
+    if(amt == 0) return;
+    auto count = this->m_count;
+    this->reserve(this->grown(count + amt));
+    if(this->m_data.mappable()) this->m_data.upload_data_impl(reinterpret_cast<const unsigned char*>(ptr), sizeof(T) * amt, sizeof(T) * count);
+    else this->m_appended.insert(this->m_appended.end(), ptr, ptr + amt);
+    this->m_count = count + amt;
+  }
+
+  inline auto clear() -> void {this->m_count = 0; this->m_appended.clear();}
+
+  auto buffer() const -> const MemoryBuffer& {this->upload_appended(); return this->m_data;}
+  auto buffer() -> MemoryBuffer& {this->upload_appended(); return this->m_data;}
+  inline auto handle() const -> std::int32_t {this->upload_appended(); return this->m_data.handle();}
+  [[nodiscard]] inline auto device_address() const -> std::uint64_t {this->upload_appended(); return this->m_data.device_address();}
+
+  // A view of `count` elements, starting at element `first`.
+  [[nodiscard]] inline auto slice(std::size_t first, std::size_t count) const -> VectorSlice<T> {
+    return VectorSlice<T>(*this, first, count);
   }
-  auto buffer() const -> const MemoryBuffer& {return this->m_data;}
-  auto buffer() -> MemoryBuffer& {return this->m_data;}
-  inline auto handle() const -> std::int32_t {return this->m_data.handle();}
 private:
+  inline auto grown(std::size_t amt) const -> std::size_t {
+    return amt <= this->capacity() ? this->capacity() : std::max(amt, this->capacity() * 2);
+  }
+
+  // Uploads whatever was appended since the buffer was last used. The elements are already part of the vector, so this
+  // only changes where they live.
+  inline auto upload_appended() const -> void {
+    if(this->m_appended.empty()) return;
+    auto first = this->m_count - this->m_appended.size();
+    auto bytes = reinterpret_cast<const unsigned char*>(this->m_appended.data());
+    const_cast<MemoryBuffer&>(this->m_data).upload_data_impl(bytes, sizeof(T) * this->m_appended.size(), sizeof(T) * first);
+    this->m_appended.clear();
+  }
+
+  // Moves into a new buffer of `amt` elements, keeping as many of the current elements as fit.
+  inline auto reallocate(std::size_t amt, MemoryType type) -> void {
+    this->upload_appended();
+    auto keep = std::min(this->m_count, amt);
+    reallocate_buffer(this->m_data, this->m_gpu, sizeof(T) * amt, sizeof(T) * keep, type);
+    this->m_type = type;
+    this->m_count = keep;
+  }
+
   MemoryBuffer m_data;
+  mutable std::vector<T> m_appended; // The last elements, appended but not uploaded yet.
+  std::size_t m_count = 0;
+  int m_gpu = 0;
+  MemoryType m_type = MemoryType::General;
+};
+
+// A typed BufferRange over a Vector's elements.
+template<typename T>
+class VectorSlice {
+public:
+  VectorSlice() = default;
+  VectorSlice(const Vector<T>& vec, std::size_t first, std::size_t count)
+    : m_range(vec.buffer(), first * sizeof(T), count * sizeof(T)), m_first(first), m_count(count) {}
+  ~VectorSlice() = default;
+  [[nodiscard]] auto first() const -> std::size_t {return this->m_first;}
+  [[nodiscard]] auto size() const -> std::size_t {return this->m_count;}
+  [[nodiscard]] auto range() const -> const BufferRange& {return this->m_range;}
+  [[nodiscard]] auto device_address() const -> std::uint64_t {return this->m_range.device_address();}
+  operator BufferRange() const {return this->m_range;}
+private:
+  BufferRange m_range;
+  std::size_t m_first = 0;
+  std::size_t m_count = 0;
 };
 
 auto unmap_mapped_buffer(std::int32_t handle) -> void;
 
-// RAII Memory buffer. Unmaps on deconstruction. Iteratable & usable with std::algorithms.
+// Flushes the given [begin, end) byte ranges of a buffer, all in one go.
+auto flush_mapped_ranges(std::int32_t handle, const std::vector<std::pair<std::size_t, std::size_t>>& ranges) -> void;
+
+// RAII Memory buffer. Flushes what was written on deconstruction. Iteratable & usable with std::algorithms.
+// On memory that isn't host coherent, only what was written gets flushed: elements reached through the mutable
+// operator[] or marked with mark_dirty(). Mutable begin() & data() hand out raw pointers, so using them marks
+// everything. Read through a const reference to mark nothing.
 template<typename T>
 class MappedBuffer {
 public:
-  MappedBuffer() {begin_ = nullptr; end_ = nullptr;}
-  MappedBuffer(MappedBuffer&& mv) {*this = std::move(mv);}
+  MappedBuffer() {begin_ = nullptr; end_ = nullptr; m_handle = -1;}
+  MappedBuffer(MappedBuffer&& mv) {this->m_handle = -1; *this = std::move(mv);}
   MappedBuffer(const MappedBuffer& cpy) = delete;
-  ~MappedBuffer() {if(this->m_handle >= 0) unmap_mapped_buffer(this->m_handle);}
+  ~MappedBuffer() {this->flush();}
   auto operator=(const MappedBuffer& cpy) -> MappedBuffer& = delete;
   auto operator=(MappedBuffer&& mv)->MappedBuffer & {
+    this->flush();
     this->m_handle = mv.m_handle;
     this->begin_ = mv.begin_;
     this->end_ = mv.end_;
+    this->m_track = mv.m_track;
+    this->m_dirty = std::move(mv.m_dirty);
     mv.m_handle = -1;
+    mv.m_dirty.clear();
     return *this;
   };
 
   auto size() const -> std::size_t {return end_ - begin_;}
-  auto begin() -> T* {return begin_;}
+  auto begin() -> T* {this->mark_dirty(0, this->size()); return begin_;}
   auto end() -> T* {return end_;}
   auto begin() const -> const T* {return begin_;}
   auto end() const -> const T* {return end_;}
-  auto operator[](std::size_t idx) -> T& {return *(begin_ + idx);}
+  auto operator[](std::size_t idx) -> T& {this->mark_dirty(idx, 1); return *(begin_ + idx);}
   auto operator[](std::size_t idx) const -> const T& {return *(begin_ + idx);}
   auto data() const -> const T* {return this->begin_;}
-  auto data() -> T* {return this->begin_;}
+  auto data() -> T* {this->mark_dirty(0, this->size()); return this->begin_;}
+
+  // Records `count` elements starting at `first` as written.
+  auto mark_dirty(std::size_t first, std::size_t count) -> void {
+    if(!this->m_track || count == 0) return;
+    auto begin = first * sizeof(T);
+    auto end = begin + count * sizeof(T);
+
+    // Writes in order just keep growing the last range. Past a point, one range over everything is cheaper to flush.
+    if(!this->m_dirty.empty() && begin <= this->m_dirty.back().second && end >= this->m_dirty.back().first) {
+      this->m_dirty.back().first = std::min(this->m_dirty.back().first, begin);
+      this->m_dirty.back().second = std::max(this->m_dirty.back().second, end);
+    } else if(this->m_dirty.size() >= cMaxRanges) {
+      for(auto& range : this->m_dirty) {
+        begin = std::min(begin, range.first);
+        end = std::max(end, range.second);
+      }
+      this->m_dirty.assign(1, {begin, end});
+    } else {
+      this->m_dirty.emplace_back(begin, end);
+    }
+  }
+
+  // Flushes everything written so far.
+  auto flush() -> void {
+    if(this->m_handle >= 0 && !this->m_dirty.empty()) flush_mapped_ranges(this->m_handle, this->m_dirty);
+    this->m_dirty.clear();
+  }
 private:
+  static constexpr auto cMaxRanges = std::size_t(256);
   friend void unmap_mapped_buffer(std::int32_t handle);
   friend class MemoryBuffer;
+  template<typename U>
+  friend class Vector;
   std::int32_t m_handle;
   T* begin_;
   T* end_;
+  bool m_track = false;
+  std::vector<std::pair<std::size_t, std::size_t>> m_dirty;
 };
 }
 }
\ No newline at end of file
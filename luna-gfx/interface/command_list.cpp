@@ -5,21 +5,28 @@
 #include "luna-gfx/vulkan/utils/helper_functions.hpp"
 #include "luna-gfx/error/error.hpp"
 #include <algorithm>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <set>
+#include <utility>
+#include <vector>
 namespace luna {
 namespace gfx {
   CommandList::CommandList(int gpu, Queue queue) {
     this->m_handle = vulkan::create_cmd(gpu, queue);
+    this->m_type = queue;
   }
 
-  CommandList::CommandList(int gpu, CommandList& in_parent) {
-    auto& res = vulkan::global_resources();
-    auto& parent = res.cmds[in_parent.handle()];
-    this->m_handle = vulkan::create_cmd(gpu, in_parent.queue(), &parent);
+  CommandList::CommandList(int gpu, CommandList& parent) {
+    LunaAssert(parent.handle() >= 0, "Unable to make a secondary list from an invalid command buffer.");
+    this->m_handle = vulkan::create_cmd(gpu, parent.queue(), parent.handle());
+    this->m_type = parent.queue();
   }
 
   CommandList::~CommandList() {
     if(this->m_handle < 0) return;
-    vulkan::destroy_cmd(this->m_handle);
+    vulkan::defer_destroy_cmd(this->m_handle);
     this->m_handle = -1;
   }
 
@@ -42,9 +49,9 @@ namespace gfx {
     cmd.cmd.setScissor(0, sc, gpu.m_dispatch);
   }
 
-  auto CommandList::start_draw(const RenderPass& pass, int buffer_layer) -> void {
+  auto CommandList::start_draw(const RenderPass& pass, int buffer_layer, bool secondaries) -> void {
     LunaAssert(this->m_handle >= 0, "Unable to begin an invalid command buffer.");
-    vulkan::cmd_start_render_pass(this->m_handle, pass.handle(), buffer_layer);
+    vulkan::cmd_start_render_pass(this->m_handle, pass.handle(), buffer_layer, secondaries);
   }
 
   auto CommandList::end_draw() -> void {
@@ -64,13 +71,17 @@ namespace gfx {
 
   auto CommandList::submit() -> std::future<bool> {
     LunaAssert(this->m_handle >= 0, "Unable to submit an invalid command buffer.");
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto future = promise->get_future();
+    vulkan::global_resources().cmds[this->m_handle].on_complete.push_back([promise](bool ran) {promise->set_value(ran);});
     vulkan::submit_command_buffer(this->m_handle);
-    auto wait_func = [](std::int32_t handle) {
-      vulkan::synchronize_cmd(handle);
-      return true;
-    };
+    return future;
+  }
 
-    return std::async(std::launch::deferred, wait_func, this->m_handle);
+  auto CommandList::enqueue() -> SyncPoint {
+    LunaAssert(this->m_handle >= 0, "Unable to submit an invalid command buffer.");
+    vulkan::submit_command_buffer(this->m_handle);
+    return this->last_submit();
   }
 
   auto CommandList::combo_into(const Window& window) -> void {
@@ -93,14 +104,23 @@ namespace gfx {
     auto& res = vulkan::global_resources();
     auto& this_cmd = res.cmds[this->handle()];
     auto& other_cmd = res.cmds[cmd.handle()];
-    // Grab sem ownership.
-    auto sem = vulkan::create_semaphores(this_cmd.gpu, 1);
 
-    // Set it to us to signal.
-    this_cmd.sems_to_signal.push_back(sem[0]);
+    // This list's point isn't known until it's submitted, so it's handed to the other one then.
+    this_cmd.combos.push_back(cmd.handle());
+    other_cmd.pending_combos++;
+  }
 
-    // Set it to the input cmd to wait on (and eventually release).
-    other_cmd.sems_to_wait_on.push_back(sem[0]);
+  auto CommandList::wait_on(const SyncPoint& point) -> void {
+    LunaAssert(this->m_handle >= 0, "Unable to tell an invalid command buffer to wait on a sync point.");
+    if(point.value == 0) return;
+    auto& cmd = vulkan::global_resources().cmds[this->m_handle];
+    cmd.timeline_waits.push_back({vulkan::queue_timeline(point.gpu, point.queue), point.value});
+  }
+
+  auto CommandList::last_submit() const -> SyncPoint {
+    LunaAssert(this->m_handle >= 0, "Unable to get the sync point of an invalid command buffer.");
+    auto& cmd = vulkan::global_resources().cmds[this->m_handle];
+    return {cmd.gpu, this->m_type, cmd.point};
   }
 
   auto CommandList::copy(const MemoryBuffer& src, const MemoryBuffer& dst) -> void {
@@ -113,6 +133,13 @@ namespace gfx {
     vulkan::copy_buffer_to_buffer(this->m_handle, src.handle(), dst.handle(), amt);
   }
 
+  auto CommandList::copy(const BufferRange& src, const BufferRange& dst) -> void {
+    LunaAssert(this->m_handle >= 0, "Unable to record a copy buffers operation as an invalid command buffer.");
+    auto amt = std::min(src.size(), dst.size());
+    if(amt == 0) return;
+    vulkan::copy_buffer_to_buffer(this->m_handle, src.handle(), dst.handle(), amt, src.offset(), dst.offset());
+  }
+
   auto CommandList::copy(const MemoryBuffer& src, const Image& dst) -> void {
     LunaAssert(this->m_handle >= 0, "Unable to record a copy operation as an invalid command buffer.");
     vulkan::copy_buffer_to_image(this->m_handle, src.handle(), dst.handle());
@@ -120,12 +147,17 @@ namespace gfx {
 
   auto CommandList::copy(const Image& src, const Image& dst) -> void {
     LunaAssert(this->m_handle >= 0, "Unable to record a copy operation as an invalid command buffer.");
-    LunaAssert(false, "Not yet implemented");
+    vulkan::copy_image_to_image(this->m_handle, src.handle(), dst.handle());
   }
 
   auto CommandList::copy(const Image& src, const MemoryBuffer& dst) -> void {
     LunaAssert(this->m_handle >= 0, "Unable to record a copy operation as an invalid command buffer.");
-    LunaAssert(false, "Not yet implemented");
+    vulkan::copy_image_to_buffer(this->m_handle, src.handle(), dst.handle());
+  }
+
+  auto CommandList::barrier() -> void {
+    LunaAssert(this->m_handle >= 0, "Unable to record a barrier as an invalid command buffer.");
+    vulkan::memory_barrier(this->m_handle);
   }
 
   auto CommandList::bind(const BindGroup& bind_group) -> void {
@@ -133,16 +165,26 @@ namespace gfx {
     luna::vulkan::cmd_bind_descriptor(this->m_handle, bind_group.handle());
   }
 
-  auto CommandList::draw(const MemoryBuffer& vertices, std::size_t num_verts, const MemoryBuffer& indices, std::size_t num_indices, std::size_t instance_count) -> void {
+  auto CommandList::bind(const BindGroup& bind_group, const std::vector<std::uint32_t>& dynamic_offsets) -> void {
     LunaAssert(this->m_handle >= 0, "Unable to record a draw operation as an invalid command buffer.");
-    luna::vulkan::cmd_buffer_draw(this->m_handle, vertices.handle(), num_verts, indices.handle(), num_indices, instance_count);
+    luna::vulkan::cmd_bind_descriptor(this->m_handle, bind_group.handle(), dynamic_offsets);
   }
 
-  auto CommandList::draw(const MemoryBuffer& vertices, std::size_t num_verts, std::size_t instance_count) -> void {
+  auto CommandList::draw(const BufferRange& vertices, std::size_t num_verts, const BufferRange& indices, std::size_t num_indices, std::size_t instance_count) -> void {
     LunaAssert(this->m_handle >= 0, "Unable to record a draw operation as an invalid command buffer.");
-    luna::vulkan::cmd_buffer_draw(this->m_handle, vertices.handle(), num_verts, instance_count);
+    luna::vulkan::cmd_buffer_draw(this->m_handle, vertices.handle(), num_verts, indices.handle(), num_indices, instance_count, vertices.offset(), indices.offset());
+  }
+
+  auto CommandList::draw(const BufferRange& vertices, std::size_t num_verts, std::size_t instance_count) -> void {
+    LunaAssert(this->m_handle >= 0, "Unable to record a draw operation as an invalid command buffer.");
+    luna::vulkan::cmd_buffer_draw(this->m_handle, vertices.handle(), num_verts, instance_count, vertices.offset());
   }
   
+  auto CommandList::push_constants(const void* data, std::size_t size, std::size_t offset) -> void {
+    LunaAssert(this->m_handle >= 0, "Unable to record push constants as an invalid command buffer.");
+    vulkan::cmd_push_constants(this->m_handle, data, size, offset);
+  }
+
   auto CommandList::dispatch(std::size_t group_amt_x, std::size_t group_amt_y, std::size_t group_amt_z) -> void {
     LunaAssert(this->m_handle >= 0, "Unable to record a dispatch operation as an invalid command buffer.");
     vulkan::cmd_buffer_dispatch(this->m_handle, group_amt_x, group_amt_y, group_amt_z);
@@ -153,19 +195,141 @@ namespace gfx {
     vulkan::start_timestamp(this->m_handle, vk::PipelineStageFlagBits::eTopOfPipe);
   }
 
-  auto CommandList::next_subpass() -> void {
+  auto CommandList::next_subpass(bool secondaries) -> void {
     LunaAssert(this->m_handle >= 0, "Unable to advance subpasses as an invalid command buffer.");
-    vulkan::cmd_next_subpass(this->m_handle);
+    vulkan::cmd_next_subpass(this->m_handle, secondaries);
+  }
+
+  auto CommandList::execute(const std::vector<CommandList*>& secondaries) -> void {
+    LunaAssert(this->m_handle >= 0, "Unable to execute secondaries from an invalid command buffer.");
+    auto handles = std::vector<std::int32_t>();
+    handles.reserve(secondaries.size());
+    for(auto* list : secondaries) {
+      LunaAssert(list && list->handle() >= 0, "Unable to execute an invalid command buffer.");
+      handles.push_back(list->handle());
+    }
+    vulkan::cmd_execute(this->m_handle, handles);
   }
 
   auto CommandList::end_time_stamp() -> std::future<std::chrono::duration<double, std::nano>> {
     LunaAssert(this->m_handle >= 0, "Unable to end a time stamp operation as an invalid command buffer.");
     vulkan::end_timestamp(this->m_handle, vk::PipelineStageFlagBits::eBottomOfPipe);
-    auto read_func = [](std::int32_t handle) {
-      return vulkan::read_timestamp(handle);
+    auto& cmd = vulkan::global_resources().cmds[this->m_handle];
+    auto promise = std::make_shared<std::promise<std::chrono::duration<double, std::nano>>>();
+    auto future = promise->get_future();
+
+    // Read once the next submit is done, before the list can be begun again. Nothing was timed if it never ran.
+    cmd.on_complete.push_back([promise, gpu = cmd.gpu, pool = cmd.timestamp_pool](bool ran) {
+      promise->set_value(ran ? vulkan::read_timestamp(gpu, pool) : std::chrono::duration<double, std::nano>(0));
+    });
+    return future;
+  }
+
+  auto submit(const std::vector<CommandList*>& lists) -> std::future<bool> {
+    using Key = std::pair<int, vk::Queue>;
+    auto& res = vulkan::global_resources();
+    auto combod = [&res](const CommandList* from, const CommandList* into) {
+      auto& combos = res.cmds[from->handle()].combos;
+      return std::find(combos.begin(), combos.end(), into->handle()) != combos.end();
     };
 
-    return std::async(std::launch::deferred, read_func, this->m_handle);
+    for(auto index = 0u; index < lists.size(); index++) {
+      auto given = lists.begin() + index;
+      LunaAssert(*given && (*given)->handle() >= 0, "Unable to submit an invalid command buffer.");
+      LunaAssert(std::find(lists.begin(), given, *given) == given, "Submitting the same command list twice in one batch.");
+    }
+
+    // A list has to be submitted before the ones it's combo'd into, so those go after it. Otherwise lists keep the
+    // order they're given in.
+    auto sorted = std::vector<CommandList*>();
+    while(sorted.size() < lists.size()) {
+      auto pending = [&sorted](const CommandList* list) {return std::find(sorted.begin(), sorted.end(), list) == sorted.end();};
+      auto ready = std::find_if(lists.begin(), lists.end(), [&](const CommandList* list) {
+        return pending(list) && std::none_of(lists.begin(), lists.end(), [&](const CommandList* from) {
+          return from != list && pending(from) && combod(from, list);
+        });
+      });
+      LunaAssert(ready != lists.end(), "Command lists in one submit can't be combo'd into each other in a loop.");
+      sorted.push_back(*ready);
+    }
+
+    // Lists that fall back onto the same queue still share a submit.
+    auto order = std::vector<Key>();
+    auto batches = std::map<Key, std::vector<CommandList*>>();
+    auto keys = std::map<const CommandList*, Key>();
+    for(auto* list : sorted) {
+      auto& cmd = res.cmds[list->handle()];
+      auto key = std::make_pair(cmd.gpu, res.devices[cmd.gpu].queue_owner(cmd.queue).queue);
+      auto& batch = batches[key];
+      if(batch.empty()) order.push_back(key);
+      batch.push_back(list);
+      keys[list] = key;
+    }
+
+    // Each queue's lists go in one vkQueueSubmit, so a whole batch goes after every batch with lists combo'd into it.
+    auto depends_on = std::map<Key, std::set<Key>>();
+    for(auto* from : sorted) {
+      for(auto* into : sorted) {
+        if(keys[from] != keys[into] && combod(from, into)) depends_on[keys[into]].insert(keys[from]);
+      }
+    }
+    auto sorted_order = std::vector<Key>();
+    while(sorted_order.size() < order.size()) {
+      auto ready = std::find_if(order.begin(), order.end(), [&](const Key& key) {
+        auto done = [&sorted_order](const Key& other) {return std::find(sorted_order.begin(), sorted_order.end(), other) != sorted_order.end();};
+        auto& deps = depends_on[key];
+        return !done(key) && std::all_of(deps.begin(), deps.end(), done);
+      });
+      LunaAssert(ready != order.end(), "Lists on two queues can't be combo'd into each other both ways in one submit.");
+      sorted_order.push_back(*ready);
+    }
+    order = std::move(sorted_order);
+
+    // Queues count up, so the last list of each batch finishing covers everything before it. The future is ready once
+    // every batch's last list is, and only true if they all ran.
+    auto promise = std::make_shared<std::promise<bool>>();
+    auto remaining = std::make_shared<std::atomic<std::size_t>>(order.size());
+    auto all_ran = std::make_shared<std::atomic<bool>>(true);
+    auto future = promise->get_future();
+    for(auto& key : order) {
+      auto& batch = batches[key];
+      auto handles = std::vector<std::int32_t>();
+      for(auto* list : batch) handles.push_back(list->handle());
+      res.cmds[handles.back()].on_complete.push_back([promise, remaining, all_ran](bool ran) {
+        if(!ran) *all_ran = false;
+        if(--*remaining == 0) promise->set_value(*all_ran);
+      });
+      vulkan::submit_command_buffers(handles);
+    }
+    if(order.empty()) promise->set_value(true);
+    return future;
+  }
+
+  auto on_complete(const SyncPoint& point, std::function<void()> callback) -> void {
+    if(point.value == 0) {
+      callback();
+      return;
+    }
+    auto timeline = vulkan::queue_timeline(point.gpu, point.queue);
+    vulkan::global_resources().completion_services[point.gpu].watch(point.gpu, timeline, point.value, std::move(callback));
+  }
+
+  auto is_complete(const SyncPoint& point) -> bool {
+    if(point.value == 0) return true;
+    auto& device = vulkan::global_resources().devices[point.gpu];
+    auto timeline = vulkan::queue_timeline(point.gpu, point.queue);
+    return vulkan::error(device.gpu.getSemaphoreCounterValue(timeline, device.m_dispatch)) >= point.value;
+  }
+
+  auto synchronize(const SyncPoint& point) -> void {
+    if(point.value == 0) return;
+    auto& device = vulkan::global_resources().devices[point.gpu];
+    auto timeline = vulkan::queue_timeline(point.gpu, point.queue);
+    auto info = vk::SemaphoreWaitInfo();
+    info.setSemaphoreCount(1);
+    info.setPSemaphores(&timeline);
+    info.setPValues(&point.value);
+    vulkan::error(device.gpu.waitSemaphores(info, UINT64_MAX, device.m_dispatch));
   }
 }
 }
\ No newline at end of file
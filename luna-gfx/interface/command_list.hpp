@@ -1,10 +1,13 @@
 #pragma once
 #include "luna-gfx/interface/buffer.hpp"
+#include <algorithm>
 #include <memory>
 #include <cstddef>
 #include <cstdint>
 #include <chrono>
+#include <functional>
 #include <future>
+#include <vector>
 
 namespace luna {
 namespace gfx {
@@ -21,43 +24,102 @@ enum class Queue {
   Compute,
   Transfer
 };
+
+/** A point in the work submitted to one of a GPU's queues. Each queue counts up with every submit made to it, so
+ * reaching a point means everything submitted to that queue up to it has finished.
+ */
+struct SyncPoint {
+  int gpu = -1;
+  Queue queue = Queue::All;
+  std::uint64_t value = 0;
+};
+
+// Whether the GPU has reached the point. Never blocks.
+[[nodiscard]] auto is_complete(const SyncPoint& point) -> bool;
+
+// Blocks until the GPU reaches the point.
+auto synchronize(const SyncPoint& point) -> void;
+
+/** Runs the callback once the GPU reaches the point, without anything having to wait for it.
+ * Callbacks run on the GPU's completion thread, one after another, so they should be quick & never block on the GPU.
+ * Futures from submit() & end_time_stamp() are fulfilled from the same thread.
+ */
+auto on_complete(const SyncPoint& point, std::function<void()> callback) -> void;
+
+// Whether a future is ready to get() without blocking. Submit futures are fulfilled by the completion thread, so this
+// is a cheap way to poll them from a frame loop.
+template<typename T>
+[[nodiscard]] auto is_ready(const std::future<T>& future) -> bool {
+  return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+/** Command lists are allocated from a pool owned by the creating thread, so recording never has to lock.
+ * A list may be created, recorded and submitted from any thread, but should be recorded on the thread that made it.
+ * Lists destroyed on another thread are handed back to their pool's thread to free, or freed right away once that
+ * thread has exited. An exited thread's pool is destroyed along with its last list.
+ *
+ * To record one render pass across threads, start it with `secondaries` set, have each thread record its own secondary
+ * list made from this one, then execute() them all.
+ */
 class CommandList {
   public:
     CommandList(const CommandList& cpy) = delete;
     auto operator=(const CommandList& cpy) -> CommandList& = delete;
 
-    CommandList() {this->m_handle = -1;}
+    CommandList() {this->m_handle = -1; this->m_type = Queue::All;}
     CommandList(int gpu, Queue queue = Queue::All);
+    // A secondary list, run through parent.execute(). When begun, it continues whatever render pass & subpass the
+    // parent is in at that moment, so begin it after the parent's start_draw().
     CommandList(int gpu, CommandList& parent);
     CommandList(CommandList&& mv) {*this = std::move(mv);};
     ~CommandList();
 
     auto begin() -> void;
     auto end() -> void;
-    auto start_draw(const RenderPass& pass, int buffer_layer = 0) -> void;
+    // With `secondaries`, the subpass is drawn only by lists passed to execute() rather than recorded inline.
+    auto start_draw(const RenderPass& pass, int buffer_layer = 0, bool secondaries = false) -> void;
     auto end_draw() -> void; 
 
-    // Returns a future that is ready when the submit is finished executing on the gpu.
+    // Returns a future that is ready when the submit is finished executing on the gpu. See is_ready() to poll it.
     [[nodiscard]] auto submit() -> std::future<bool>;
+
+    // Submits without making a future, so the completion thread never has to watch for it. Returns the point the
+    // submit reaches, to poll, wait or register a callback on if needed.
+    auto enqueue() -> SyncPoint;
     auto combo_into(const Window& window) -> void;
+
+    // Makes the other list's next submit wait on this one's. This one has to be submitted first.
     auto combo_into(const CommandList& cmd) -> void;
+
+    // Makes the next submit wait on the GPU reaching a point, on any of its queues.
+    auto wait_on(const SyncPoint& point) -> void;
+
+    // The point reached once the last submit of this list is done.
+    [[nodiscard]] auto last_submit() const -> SyncPoint;
     auto start_time_stamp() -> void;
 
-    // Returns a future that returns the time it took for the GPU to perform any of the in-between actions.
+    // Returns a future that returns the time it took for the GPU to perform any of the in-between actions. It's ready
+    // once the next submit is done, or with zero if the list is destroyed without being submitted.
     [[nodiscard]] auto end_time_stamp() -> std::future<std::chrono::duration<double, std::nano>>;
 
+    // Makes every write recorded before it visible to everything recorded after it.
     auto barrier() -> void;
     auto flush() -> void;
     auto viewport(const Viewport& view) -> void;
 
     template<typename T>
-    auto copy(const Vector<T>& src, const Vector<T>& dst) -> void {this->copy(src.buffer(), dst.buffer());}
+    auto copy(const Vector<T>& src, const Vector<T>& dst) -> void {this->copy(src.buffer(), dst.buffer(), std::min(src.size(), dst.size()) * sizeof(T));}
 
     template<typename T>
     auto copy(const Vector<T>& src, const Vector<T>& dst, std::size_t amt) -> void {this->copy(src.buffer(), dst.buffer(), amt);}
     auto copy(const MemoryBuffer& src, const MemoryBuffer& dst) -> void;
     auto copy(const MemoryBuffer& src, const MemoryBuffer& dst, std::size_t amt) -> void;
 
+    // Copies as much of one range as fits into the other.
+    template<typename T>
+    auto copy(const VectorSlice<T>& src, const VectorSlice<T>& dst) -> void {this->copy(src.range(), dst.range());}
+    auto copy(const BufferRange& src, const BufferRange& dst) -> void;
+
     template<typename T>
     auto copy(const Vector<T>& src, const Image& dst) -> void {this->copy(src.buffer(), dst);}
 
@@ -70,28 +132,62 @@ class CommandList {
     auto copy(const Image& src, const MemoryBuffer& dst) -> void;
     auto bind(const BindGroup& bind_group) -> void;
 
+    // Binds with one offset per dynamic binding of the group, in binding order. See gfx::TransientRing.
+    auto bind(const BindGroup& bind_group, const std::vector<std::uint32_t>& dynamic_offsets) -> void;
+
     template<typename V, typename T>
     auto draw(const Vector<V>& vertices, const Vector<T>& indices, std::size_t instance_count = 1) -> void {
-      this->draw(vertices.buffer(), vertices.buffer().size()/sizeof(V), indices.buffer(), indices.buffer().size()/sizeof(T), instance_count); 
+      this->draw(vertices.buffer(), vertices.size(), indices.buffer(), indices.size(), instance_count); 
     }
 
     template<typename V>
     auto draw(const Vector<V>& vertices, std::size_t instance_count = 1) -> void {
-      this->draw(vertices.buffer(), vertices.buffer().size()/sizeof(V), instance_count); 
+      this->draw(vertices.buffer(), vertices.size(), instance_count); 
     }
 
-    auto draw(const MemoryBuffer& vertices, std::size_t num_verts, const MemoryBuffer& indices, std::size_t num_indices, std::size_t instance_count = 1) -> void;
-    auto draw(const MemoryBuffer& vertices, std::size_t num_verts, std::size_t instance_count = 1) -> void;
+    template<typename V, typename T>
+    auto draw(const VectorSlice<V>& vertices, const VectorSlice<T>& indices, std::size_t instance_count = 1) -> void {
+      this->draw(vertices.range(), vertices.size(), indices.range(), indices.size(), instance_count);
+    }
+
+    template<typename V>
+    auto draw(const VectorSlice<V>& vertices, std::size_t instance_count = 1) -> void {
+      this->draw(vertices.range(), vertices.size(), instance_count);
+    }
+
+    // Buffers convert to ranges over their whole size. Vertices & indices are read starting at their range's offset.
+    auto draw(const BufferRange& vertices, std::size_t num_verts, const BufferRange& indices, std::size_t num_indices, std::size_t instance_count = 1) -> void;
+    auto draw(const BufferRange& vertices, std::size_t num_verts, std::size_t instance_count = 1) -> void;
+
+    // Writes into the push constant range of the pipeline last bound, at `offset` bytes. Cheaper than a descriptor
+    // write for small per-draw data, like the device addresses of the buffers a draw reads.
+    template<typename T>
+    auto push_constants(const T& value, std::size_t offset = 0) -> void {this->push_constants(&value, sizeof(T), offset);}
+    auto push_constants(const void* data, std::size_t size, std::size_t offset = 0) -> void;
 
     auto dispatch(std::size_t group_amt_x, std::size_t group_amt_y = 1, std::size_t group_amt_z = 1) -> void;
-    auto next_subpass() -> void;
+    auto next_subpass(bool secondaries = false) -> void;
+
+    // Runs secondary lists made from this one. Each must be ended, and stays in use until this list's next submit is done.
+    auto execute(const std::vector<CommandList*>& secondaries) -> void;
     
     [[nodiscard]] auto queue() const {return this->m_type;}
     [[nodiscard]] auto handle() const {return this->m_handle;}
-    auto operator=(CommandList&& mv) -> CommandList& {this->m_handle = mv.handle(); mv.m_handle = -1; return *this;};
+    auto operator=(CommandList&& mv) -> CommandList& {this->m_handle = mv.handle(); this->m_type = mv.m_type; mv.m_handle = -1; return *this;};
   private:
+    friend class FrameCommands;
+    // Wraps a command buffer that was already created, taking ownership of it.
+    static auto adopt(std::int32_t handle, Queue queue) -> CommandList {auto out = CommandList(); out.m_handle = handle; out.m_type = queue; return out;}
+
     std::int32_t m_handle;
     Queue m_type;
 };
+
+/** Submits many lists at once. Lists going to the same queue share a single vkQueueSubmit. Lists are submitted after
+ * any combo'd into them, whatever order they're given in, and otherwise in the order given. Since each queue's lists go
+ * in one submit, lists on two queues can't be combo'd into each other both ways in one call.
+ * Returns a future that's ready once all of them are done, holding false if any was destroyed before it ran.
+ */
+[[nodiscard]] auto submit(const std::vector<CommandList*>& lists) -> std::future<bool>;
 }
 }
\ No newline at end of file
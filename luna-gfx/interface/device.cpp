@@ -2,6 +2,7 @@
 #include "luna-gfx/vulkan/utils/helper_functions.hpp"
 #include "luna-gfx/vulkan/global_resources.hpp"
 #include "luna-gfx/error/error.hpp"
+#include <utility>
 
 namespace luna {
 namespace gfx {
@@ -12,6 +13,10 @@ auto gpu_info() -> std::vector<GPUInfo> {
   for(auto i = 0u; i < vec.size(); ++i) {
     vec[i].name = res.devices[i].properties.deviceName.data();
     vec[i].dedicated_card = res.devices[i].properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu;
+    vec[i].buffer_device_address = res.devices[i].buffer_device_address;
+    vec[i].resizable_bar = res.devices[i].resizable_bar;
+    vec[i].host_image_copy = res.devices[i].host_image_copy;
+    vec[i].heaps = res.memory_budgets[i].heaps(i);
   }
 
   return vec;
@@ -20,7 +25,47 @@ auto gpu_info() -> std::vector<GPUInfo> {
 auto synchronize_gpu(int gpu) -> void {
   auto& res = luna::vulkan::global_resources();
   auto& device = res.devices[gpu];
-  vulkan::error(device.gpu.waitIdle(device.m_dispatch));
+  device.wait_idle();
+
+  // Everything submitted has finished, so anything waiting to be destroyed can go now.
+  res.deletion_queues[gpu].collect(device);
+}
+
+auto memory_heaps(int gpu) -> std::vector<MemoryHeapInfo> {
+  return luna::vulkan::global_resources().memory_budgets[gpu].heaps(gpu);
+}
+
+auto update_memory_budget(int gpu) -> void {
+  luna::vulkan::global_resources().memory_budgets[gpu].next_frame(gpu);
+}
+
+auto memory_usage(int gpu, MemoryType type) -> std::size_t {
+  return luna::vulkan::global_resources().memory_budgets[gpu].usage(type);
+}
+
+auto image_memory_usage(int gpu) -> std::size_t {
+  return luna::vulkan::global_resources().memory_budgets[gpu].image_usage();
+}
+
+auto on_memory_pressure(int gpu, float threshold, MemoryPressureCallback callback) -> std::int32_t {
+  LunaAssert(callback, "Attempting to register an empty memory pressure callback.");
+  return luna::vulkan::global_resources().memory_budgets[gpu].add_callback(threshold, std::move(callback));
+}
+
+auto remove_memory_pressure_callback(int gpu, std::int32_t id) -> void {
+  luna::vulkan::global_resources().memory_budgets[gpu].remove_callback(id);
+}
+
+auto configure_memory_pool(int gpu, MemoryType type, const MemoryPoolInfo& info) -> void {
+  luna::vulkan::global_resources().memory_pools[gpu].configure(gpu, type, info);
+}
+
+auto memory_pool_usage(int gpu, MemoryType type) -> MemoryPoolUsage {
+  return luna::vulkan::global_resources().memory_pools[gpu].usage(gpu, type);
+}
+
+auto defragment(int gpu, std::chrono::microseconds budget) -> DefragmentStats {
+  return luna::vulkan::global_resources().defragmenters[gpu].step(gpu, budget);
+}
 }
 }
-}
\ No newline at end of file
@@ -1,14 +1,88 @@
-#pragma once 
+#pragma once
+#include "luna-gfx/interface/buffer.hpp"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 namespace luna {
 namespace gfx {
+struct MemoryHeapInfo {
+  std::size_t size = 0;    // Total bytes in the heap.
+  std::size_t budget = 0;  // Bytes this process can use before allocations start failing or getting paged out.
+  std::size_t usage = 0;   // Bytes this process is using, counting memory allocated outside of luna.
+  bool device_local = false;
+};
+
 struct GPUInfo {
   std::string name;
   bool dedicated_card;
+  bool buffer_device_address; // Whether MemoryBuffer::device_address() works.
+  bool resizable_bar;         // Whether the host can write all of VRAM, so Streaming memory is device local.
+  bool host_image_copy;       // Whether uploads to textures that aren't attachments can skip staging.
+  std::vector<MemoryHeapInfo> heaps;
+};
+
+struct MemoryPressure {
+  int gpu = -1;
+  std::size_t heap = 0;
+  std::size_t usage = 0;
+  std::size_t budget = 0;
+  bool out_of_memory = false; // An allocation already failed, and gets tried again once every callback returns.
+};
+
+struct DefragmentStats {
+  std::size_t bytes_moved = 0;
+  std::size_t allocations_moved = 0;
+  bool finished = false; // Nothing's left to move. The next call starts over.
+};
+
+// How buffers of one MemoryType get their memory. Each type allocates out of its own blocks, so they don't fragment one
+// another. Buffers that don't fit (too big, or the pool's full) fall back on the allocator's shared memory.
+struct MemoryPoolInfo {
+  std::size_t block_size = 64u * 1024u * 1024u; // Zero leaves it up to the allocator.
+  std::size_t max_blocks = 0;                   // Zero for no limit.
+
+  // Buffers smaller than this bump allocate out of a linear pool of their own. Its memory is reused once what comes
+  // before it is freed, so it suits small buffers that come & go in order. Zero turns it off.
+  std::size_t small_threshold = 64u * 1024u;
+  std::size_t small_block_size = 4u * 1024u * 1024u;
 };
 
+struct MemoryPoolUsage {
+  std::size_t allocations = 0;       // In the type's pool.
+  std::size_t small_allocations = 0; // In its linear pool for small buffers.
+  std::size_t retired_pools = 0;     // Replaced by a later configure, and still holding buffers.
+};
+
+using MemoryPressureCallback = std::function<void(const MemoryPressure&)>;
+
 auto gpu_info() -> std::vector<GPUInfo>;
 auto synchronize_gpu(int gpu) -> void;
+
+// Budgets are re-read from the driver once a frame, when a window presents. Headless apps call update_memory_budget instead.
+auto memory_heaps(int gpu) -> std::vector<MemoryHeapInfo>;
+auto update_memory_budget(int gpu) -> void;
+
+// Bytes held by buffers of the given type, or by images.
+auto memory_usage(int gpu, MemoryType type) -> std::size_t;
+auto image_memory_usage(int gpu) -> std::size_t;
+
+// The callback runs every frame a heap's usage is over `threshold` of its budget, and right away if an allocation fails.
+// It's called without any lock held, so it's free to destroy resources, but shouldn't create any. Returns an id for removal.
+auto on_memory_pressure(int gpu, float threshold, MemoryPressureCallback callback) -> std::int32_t;
+auto remove_memory_pressure_callback(int gpu, std::int32_t id) -> void;
+
+// Only affects buffers created afterwards. The pools it replaces are destroyed once the last of their buffers is.
+// MemoryType::Unknown buffers are never pooled, so configuring it does nothing.
+auto configure_memory_pool(int gpu, MemoryType type, const MemoryPoolInfo& info) -> void;
+auto memory_pool_usage(int gpu, MemoryType type) -> MemoryPoolUsage;
+
+// Compacts device memory by moving buffers & images, for roughly `budget` of time. Meant to be called once a frame
+// until it reports being finished. Handles stay valid & nothing blocks on the GPU; a pass's copies are finished off by a
+// later call. Moved resources are only swapped in while no command list on the GPU is being recorded. Any list recorded
+// before that which uses a moved resource has to be recorded again.
+auto defragment(int gpu, std::chrono::microseconds budget) -> DefragmentStats;
 }
 }
\ No newline at end of file
@@ -0,0 +1,114 @@
+#include "luna-gfx/interface/frame_commands.hpp"
+#include "luna-gfx/vulkan/utils/helper_functions.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <algorithm>
+#include <deque>
+#include <utility>
+namespace luna {
+namespace gfx {
+struct FrameCommands::Frame {
+  vk::CommandPool pool = {};
+  std::deque<CommandList> primaries;   // Deques, so handed out references survive them growing.
+  std::deque<CommandList> secondaries;
+  std::size_t used_primaries = 0;
+  std::size_t used_secondaries = 0;
+  SyncPoint done = {};                 // Reached once the last submit to run any of the frame's lists is done.
+};
+
+FrameCommands::FrameCommands() = default;
+
+FrameCommands::FrameCommands(int gpu, Queue queue, std::size_t frames) {
+  LunaAssert(frames > 0, "Frame commands need at least one frame to hand lists out from.");
+  this->m_gpu = gpu;
+  this->m_queue = queue;
+  this->m_frames.reserve(frames);
+  for(auto index = 0u; index < frames; index++) {
+    this->m_frames.push_back(std::make_unique<Frame>());
+    this->m_frames.back()->pool = vulkan::create_transient_pool(gpu, queue);
+  }
+}
+
+FrameCommands::FrameCommands(FrameCommands&& mv) {
+  *this = std::move(mv);
+}
+
+FrameCommands::~FrameCommands() {
+  this->release();
+}
+
+auto FrameCommands::operator=(FrameCommands&& mv) -> FrameCommands& {
+  this->release();
+  this->m_gpu = mv.m_gpu;
+  this->m_queue = mv.m_queue;
+  this->m_current = mv.m_current;
+  this->m_frames = std::move(mv.m_frames);
+  mv.m_gpu = -1;
+  mv.m_current = 0;
+  mv.m_frames.clear();
+  return *this;
+}
+
+auto FrameCommands::next() -> CommandList& {
+  LunaAssert(this->m_gpu >= 0, "Attempting to get a command list from invalid frame commands.");
+  auto& frame = *this->m_frames[this->m_current];
+  if(frame.used_primaries == frame.primaries.size()) {
+    auto handle = vulkan::create_cmd(this->m_gpu, this->m_queue, -1, frame.pool);
+    frame.primaries.push_back(CommandList::adopt(handle, this->m_queue));
+  }
+  return frame.primaries[frame.used_primaries++];
+}
+
+auto FrameCommands::next(CommandList& parent) -> CommandList& {
+  LunaAssert(this->m_gpu >= 0, "Attempting to get a command list from invalid frame commands.");
+  LunaAssert(parent.handle() >= 0, "Unable to make a secondary list from an invalid command buffer.");
+  auto& frame = *this->m_frames[this->m_current];
+  if(frame.used_secondaries == frame.secondaries.size()) {
+    auto handle = vulkan::create_cmd(this->m_gpu, this->m_queue, parent.handle(), frame.pool);
+    frame.secondaries.push_back(CommandList::adopt(handle, this->m_queue));
+  }
+
+  // Recycled secondaries may have been run by a different list last time around.
+  auto& list = frame.secondaries[frame.used_secondaries++];
+  vulkan::global_resources().cmds[list.handle()].parent = parent.handle();
+  return list;
+}
+
+auto FrameCommands::next_frame() -> void {
+  LunaAssert(this->m_gpu >= 0, "Attempting to advance invalid frame commands.");
+  auto& res = vulkan::global_resources();
+  auto& ending = *this->m_frames[this->m_current];
+
+  // Only this frame's own submits matter, not whatever else went to the GPU meanwhile. Secondaries are run by their
+  // parent's submit, and every list here goes to the same queue, so the latest point of them all covers the frame.
+  ending.done = {this->m_gpu, this->m_queue, 0};
+  auto track = [&](std::int32_t handle) {
+    if(!res.cmds.valid(handle)) return;
+    ending.done.value = std::max(ending.done.value, res.cmds[handle].point);
+  };
+  for(auto index = 0u; index < ending.used_primaries; index++) track(ending.primaries[index].handle());
+  for(auto index = 0u; index < ending.used_secondaries; index++) track(res.cmds[ending.secondaries[index].handle()].parent);
+  this->m_current = (this->m_current + 1) % this->m_frames.size();
+
+  // One reset hands back everything the frame's lists recorded, instead of each list resetting itself as it's begun.
+  auto& frame = *this->m_frames[this->m_current];
+  if(frame.used_primaries == 0 && frame.used_secondaries == 0) return;
+  synchronize(frame.done);
+  vulkan::reset_transient_pool(this->m_gpu, frame.pool);
+  frame.used_primaries = 0;
+  frame.used_secondaries = 0;
+}
+
+auto FrameCommands::release() -> void {
+  // The lists are destroyed once their last submits finish, and never free into the pool, so it can go at the same time.
+  for(auto& frame : this->m_frames) {
+    frame->primaries.clear();
+    frame->secondaries.clear();
+    auto gpu = this->m_gpu;
+    auto pool = frame->pool;
+    vulkan::defer_destruction(gpu, [gpu, pool]() {vulkan::destroy_transient_pool(gpu, pool);});
+  }
+  this->m_frames.clear();
+}
+}
+}
@@ -0,0 +1,51 @@
+#pragma once
+#include "luna-gfx/interface/command_list.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace luna {
+namespace gfx {
+/** Hands out command lists that only live for a frame.
+ * Each frame in flight gets its own transient command pool. Lists are never freed: when a frame's slot comes back
+ * around, its whole pool is reset at once and the same lists are handed out again. So after the first few frames,
+ * getting a list costs nothing.
+ *
+ * Call next_frame() once a frame's lists have been submitted. Lists from next() are only valid until their slot comes
+ * back around, and should be begun at most once a frame. Not thread-safe: use one per recording thread.
+ */
+class FrameCommands {
+  public:
+    FrameCommands(const FrameCommands& cpy) = delete;
+    auto operator=(const FrameCommands& cpy) -> FrameCommands& = delete;
+
+    FrameCommands();
+    FrameCommands(int gpu, Queue queue = Queue::All, std::size_t frames = 3);
+    FrameCommands(FrameCommands&& mv);
+    ~FrameCommands();
+    auto operator=(FrameCommands&& mv) -> FrameCommands&;
+
+    // A primary list for this frame.
+    [[nodiscard]] auto next() -> CommandList&;
+
+    // A secondary list for this frame, run through parent.execute().
+    [[nodiscard]] auto next(CommandList& parent) -> CommandList&;
+
+    // Moves on to the oldest frame's pool, waiting for the GPU to finish that frame's submits first if it hasn't already.
+    auto next_frame() -> void;
+
+    [[nodiscard]] inline auto gpu() const -> int {return this->m_gpu;}
+    [[nodiscard]] inline auto frames() const -> std::size_t {return this->m_frames.size();}
+
+  private:
+    struct Frame;
+    auto release() -> void;
+
+    int m_gpu = -1;
+    Queue m_queue = Queue::All;
+    std::size_t m_current = 0;
+    std::vector<std::unique_ptr<Frame>> m_frames;
+};
+}
+}
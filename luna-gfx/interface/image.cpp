@@ -5,12 +5,17 @@
 #include <cstdint>
 namespace luna {
 namespace gfx {
+inline auto upload_size(const ImageInfo& info) -> std::size_t {
+  return info.width * info.height * luna::vulkan::size_from_format(info.format);
+}
+
 Image::Image(ImageInfo info, const unsigned char* initial_data) {
   auto usage = vulkan::usage_from_format(info.format);
   this->m_handle = luna::vulkan::create_image(info, vk::ImageLayout::eUndefined, usage, nullptr);
   this->info() = info;
   if(initial_data != nullptr) {
-    this->upload_raw(initial_data);
+    // Nothing's been recorded with the image yet, so there's no GPU work to wait on.
+    luna::vulkan::upload_image(this->m_handle, initial_data, upload_size(info), false);
   }
 }
 
@@ -20,11 +25,14 @@ Image::~Image() {
   auto& img = res.images[this->m_handle];
   // If image is imported, we leave whoever originally created it to destroy it.
   // In other words, if its imported, this is just a view to that image. Maybe should be a separate type? Idk.
-  if(!img.imported) vulkan::destroy_image(this->m_handle);
+  if(!img.imported) {
+    auto handle = this->m_handle;
+    vulkan::defer_destruction(img.info.gpu, [handle]() {vulkan::destroy_image(handle);});
+  }
   this->m_handle = -1;
 }
 
-[[nodiscard]] inline auto Image::info() const -> ImageInfo {
+auto Image::info() const -> ImageInfo {
   return vulkan::global_resources().images[this->m_handle].info;
 }
 
@@ -33,17 +41,7 @@ auto Image::view(std::size_t mip_level) -> ImageView {
 }
 
 auto Image::upload_raw(const unsigned char* ptr) -> void {
-    auto amt = this->info().width * this->info().height * luna::vulkan::size_from_format(this->info().format);
-    auto tmp_buffer = MemoryBuffer(this->info().gpu, amt, MemoryType::CPUVisible);
-    tmp_buffer.upload(ptr);
-
-    auto cmd = luna::vulkan::create_cmd(this->info().gpu);
-    luna::vulkan::begin_command_buffer(cmd);
-    luna::vulkan::copy_buffer_to_image(cmd, tmp_buffer.handle(), this->handle());
-    luna::vulkan::end_command_buffer(cmd);
-    luna::vulkan::submit_command_buffer(cmd);
-    luna::vulkan::synchronize_cmd(cmd);
-    luna::vulkan::destroy_cmd(cmd);
+    luna::vulkan::upload_image(this->handle(), ptr, upload_size(this->info()));
 }
 
 auto ImageView::name() const -> std::string {
@@ -48,13 +48,16 @@ class Image {
     }
 
     auto view(std::size_t mip_level = 1) -> ImageView;
+    // Done once this returns. Textures the device can take VK_EXT_host_image_copy writes into without losing access
+    // speed are written straight from host memory, after waiting for work already submitted. Everything else goes
+    // through a staging buffer.
     template<typename T>
     auto upload(const T* ptr) -> void {
       this->upload_raw(reinterpret_cast<const unsigned char*>(ptr));
     }
 
     [[nodiscard]] inline auto handle() const -> std::int32_t {return this->m_handle;}
-    [[nodiscard]] inline auto info() const -> ImageInfo;
+    [[nodiscard]] auto info() const -> ImageInfo;
   private:
     auto upload_raw(const unsigned char* ptr) -> void;
     friend class Window;
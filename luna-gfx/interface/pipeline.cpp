@@ -9,7 +9,8 @@ namespace gfx {
 
   ComputePipeline::~ComputePipeline() {
     if(this->m_handle < 0) return; // Don't deconstruct an invalid handle!
-    luna::vulkan::destroy_pipeline(this->m_handle);
+    auto handle = this->m_handle;
+    luna::vulkan::defer_destruction(this->m_info.gpu, [handle]() {luna::vulkan::destroy_pipeline(handle);});
     this->m_info = {};
   }
 
@@ -26,7 +27,8 @@ namespace gfx {
 
   GraphicsPipeline::~GraphicsPipeline() {
     if(this->m_handle < 0) return; // Don't deconstruct an invalid handle!
-    luna::vulkan::destroy_pipeline(this->m_handle);
+    auto handle = this->m_handle;
+    luna::vulkan::defer_destruction(this->m_info.gpu, [handle]() {luna::vulkan::destroy_pipeline(handle);});
     this->m_info = {};
   }
 
@@ -113,6 +113,9 @@ struct GraphicsPipelineInfo {
 
   // Name of the subpass this object writes to.
   std::string subpass = "Default";
+
+  // Names of uniform/storage buffers that get bound with a per-draw offset, e.g. slices of a gfx::TransientRing.
+  std::vector<std::string> dynamic_bindings;
 };
 
 struct ComputePipelineInfo {
@@ -134,6 +137,9 @@ struct ComputePipelineInfo {
 
   // The shader data that actually describes this pipeline.
   ShaderInfo shaders;
+
+  // Names of uniform/storage buffers that get bound with a per-dispatch offset, e.g. slices of a gfx::TransientRing.
+  std::vector<std::string> dynamic_bindings;
 };
 
 class ComputePipeline {
@@ -0,0 +1,161 @@
+#include "luna-gfx/interface/readback_queue.hpp"
+#include "luna-gfx/interface/image.hpp"
+#include "luna-gfx/vulkan/utils/helper_functions.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+namespace luna {
+namespace gfx {
+// Readback buffers start out big enough that a typical frame's worth of reads never has to grow one.
+constexpr auto cMinReadbackSize = std::size_t(1024) * 1024;
+
+ReadbackQueue::ReadbackQueue(int gpu, Queue queue) {
+  this->m_gpu = gpu;
+  this->m_queue = queue;
+}
+
+auto ReadbackQueue::operator=(ReadbackQueue&& mv) -> ReadbackQueue& {
+  this->m_gpu = mv.m_gpu;
+  this->m_queue = mv.m_queue;
+  this->m_pending = std::move(mv.m_pending);
+  this->m_batches = std::move(mv.m_batches);
+  mv.m_gpu = -1;
+  mv.m_pending.clear();
+  mv.m_batches.clear();
+  return *this;
+}
+
+auto ReadbackQueue::read(const BufferRange& src) -> std::future<std::vector<unsigned char>> {
+  return ReadbackQueue::future_of<unsigned char>(*this->enqueue(src));
+}
+
+auto ReadbackQueue::read(const Image& src) -> std::future<std::vector<unsigned char>> {
+  LunaAssert(this->m_gpu >= 0, "Attempting to read back through an invalid readback queue.");
+  auto& res = vulkan::global_resources();
+  auto& limits = res.devices[this->m_gpu].properties.limits;
+  auto info = src.info();
+  auto texel = vulkan::size_from_format(info.format);
+  auto row_bytes = info.width * texel;
+  auto rows = info.height * info.layers;
+
+  // Rows get padded out to the pitch the device copies fastest with, as long as that's a whole number of texels.
+  auto alignment = std::max<std::size_t>(1, limits.optimalBufferCopyRowPitchAlignment);
+  auto pitch = ((row_bytes + alignment - 1) / alignment) * alignment;
+  if(pitch % texel != 0) pitch = row_bytes;
+
+  auto ticket = std::make_shared<Ticket>();
+  ticket->gpu = this->m_gpu;
+  ticket->size = row_bytes * rows;
+  ticket->row_bytes = row_bytes;
+  ticket->pitch = pitch;
+
+  auto request = Request();
+  request.image = src.handle();
+  request.row_length = pitch / texel;
+  request.bytes = pitch * rows;
+  request.ticket = ticket;
+  this->m_pending.push_back(request);
+  return ReadbackQueue::future_of<unsigned char>(*ticket);
+}
+
+auto ReadbackQueue::submit() -> void {
+  if(this->m_pending.empty()) return;
+  auto& res = vulkan::global_resources();
+  auto& limits = res.devices[this->m_gpu].properties.limits;
+
+  // Lay every read out in the batch's buffer, each starting somewhere good for both buffer & image copies.
+  auto alignment = std::max<std::size_t>(16, limits.optimalBufferCopyOffsetAlignment);
+  auto total = std::size_t(0);
+  for(auto& request : this->m_pending) {
+    request.ticket->offset = total;
+    total += ((request.bytes + alignment - 1) / alignment) * alignment;
+  }
+
+  auto& batch = this->next_batch(total);
+  auto dst = batch.buffer->handle();
+  batch.cmd.begin();
+  auto cmd = batch.cmd.handle();
+
+  // Whatever was submitted before has to be done writing before it's read.
+  vulkan::memory_barrier(cmd, vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, vk::AccessFlagBits::eTransferRead);
+  for(auto& request : this->m_pending) {
+    request.ticket->buffer = batch.buffer;
+    if(request.buffer >= 0) vulkan::copy_buffer_to_buffer(cmd, request.buffer, dst, request.bytes, request.offset, request.ticket->offset);
+    else vulkan::copy_image_to_buffer(cmd, request.image, dst, request.ticket->offset, request.row_length);
+  }
+  vulkan::memory_barrier(cmd, vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eHost, vk::AccessFlagBits::eHostRead);
+  batch.cmd.end();
+
+  // Every read's future gets filled in from the completion thread once the copies land. The tickets hold on to the
+  // batch's buffer until then.
+  auto tickets = std::vector<std::shared_ptr<Ticket>>();
+  for(auto& request : this->m_pending) tickets.push_back(std::move(request.ticket));
+  res.cmds[batch.cmd.handle()].on_complete.push_back([tickets](bool) {
+    for(auto& ticket : tickets) ticket->fulfil(*ticket);
+  });
+
+  vulkan::submit_command_buffer(batch.cmd.handle());
+  batch.serial = res.cmds[batch.cmd.handle()].serial;
+  this->m_pending.clear();
+}
+
+auto ReadbackQueue::enqueue(const BufferRange& src) -> std::shared_ptr<Ticket> {
+  LunaAssert(this->m_gpu >= 0, "Attempting to read back through an invalid readback queue.");
+  auto ticket = std::make_shared<Ticket>();
+  ticket->gpu = this->m_gpu;
+  ticket->size = src.size();
+
+  auto request = Request();
+  request.buffer = src.handle();
+  request.offset = src.offset();
+  request.bytes = src.size();
+  request.ticket = ticket;
+  this->m_pending.push_back(request);
+  return ticket;
+}
+
+auto ReadbackQueue::next_batch(std::size_t size) -> Batch& {
+  auto& res = vulkan::global_resources();
+  auto& device = res.devices[this->m_gpu];
+  auto& queue = res.deletion_queues[this->m_gpu];
+
+  // A batch can be reused once the GPU is done with it & every read has been copied out of its buffer.
+  for(auto& batch : this->m_batches) {
+    if(batch.buffer.use_count() == 1 && queue.is_complete(device, batch.serial)) {
+      if(batch.buffer->size() < size) batch.buffer = std::make_shared<MemoryBuffer>(this->m_gpu, std::max(size, batch.buffer->size() * 2), MemoryType::Readback);
+      return batch;
+    }
+  }
+
+  auto batch = Batch();
+  batch.cmd = CommandList(this->m_gpu, this->m_queue);
+  batch.buffer = std::make_shared<MemoryBuffer>(this->m_gpu, std::max(size, cMinReadbackSize), MemoryType::Readback);
+  this->m_batches.push_back(std::move(batch));
+  return this->m_batches.back();
+}
+
+auto ReadbackQueue::fetch(const Ticket& ticket, void* out) -> void {
+  if(ticket.size == 0) return;
+  auto& res = vulkan::global_resources();
+
+  auto rows = ticket.row_bytes > 0 ? ticket.size / ticket.row_bytes : 1;
+  auto row_bytes = ticket.row_bytes > 0 ? ticket.row_bytes : ticket.size;
+  auto pitch = ticket.row_bytes > 0 ? ticket.pitch : ticket.size;
+  auto bytes = (rows - 1) * pitch + row_bytes;
+
+  auto& buffer = res.buffers[ticket.buffer->handle()];
+  if(!buffer.coherent) vmaInvalidateAllocation(res.allocators[ticket.gpu], buffer.alloc, ticket.offset, bytes);
+
+  auto* src = static_cast<const unsigned char*>(buffer.mapped) + ticket.offset;
+  auto* dst = static_cast<unsigned char*>(out);
+  if(pitch == row_bytes) {
+    std::memcpy(dst, src, ticket.size);
+    return;
+  }
+
+  for(auto row = 0u; row < rows; row++) std::memcpy(dst + row * row_bytes, src + row * pitch, row_bytes);
+}
+}
+}
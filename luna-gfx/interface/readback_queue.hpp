@@ -0,0 +1,103 @@
+#pragma once
+#include "luna-gfx/interface/buffer.hpp"
+#include "luna-gfx/interface/command_list.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace luna {
+namespace gfx {
+class Image;
+
+/** Pulls results back from the GPU without stalling on them.
+ * Reads are recorded when submit() is called, which copies everything asked for since the last submit into one host
+ * cached buffer with a single command list. Those buffers are kept in a ring, and one is reused once its copies have
+ * finished & every future reading from it is gone, so reading back every frame doesn't allocate.
+ *
+ * Each read returns a future of the data, which the device's completion thread fills in once its submission finishes,
+ * so is_ready() can poll it. A read that's never submitted is never filled in, and its future is broken once the
+ * queue goes. Reads see everything submitted to the same queue before them.
+ */
+class ReadbackQueue {
+  public:
+    ReadbackQueue(const ReadbackQueue& cpy) = delete;
+    auto operator=(const ReadbackQueue& cpy) -> ReadbackQueue& = delete;
+
+    ReadbackQueue() = default;
+    explicit ReadbackQueue(int gpu, Queue queue = Queue::Graphics);
+    ReadbackQueue(ReadbackQueue&& mv) {*this = std::move(mv);}
+    ~ReadbackQueue() = default;
+    auto operator=(ReadbackQueue&& mv) -> ReadbackQueue&;
+
+    template<typename T>
+    [[nodiscard]] auto read(const Vector<T>& src) -> std::future<std::vector<T>> {return this->read(src.slice(0, src.size()));}
+
+    template<typename T>
+    [[nodiscard]] auto read(const VectorSlice<T>& src) -> std::future<std::vector<T>> {return ReadbackQueue::future_of<T>(*this->enqueue(src.range()));}
+
+    [[nodiscard]] auto read(const BufferRange& src) -> std::future<std::vector<unsigned char>>;
+
+    // Rows come back tightly packed, whatever pitch the copy used.
+    [[nodiscard]] auto read(const Image& src) -> std::future<std::vector<unsigned char>>;
+
+    // Records every pending read into one command list & submits it.
+    auto submit() -> void;
+
+    [[nodiscard]] inline auto pending() const -> std::size_t {return this->m_pending.size();}
+    [[nodiscard]] inline auto gpu() const -> int {return this->m_gpu;}
+
+  private:
+    struct Batch {
+      CommandList cmd;
+      std::shared_ptr<MemoryBuffer> buffer; // Futures hold on to this until they've read their data out.
+      std::uint64_t serial = 0;
+    };
+
+    // Where a read's data ends up. Everything but the size is filled in on submit.
+    struct Ticket {
+      std::function<void(Ticket&)> fulfil; // Copies the data out into the read's future, once it's landed.
+      int gpu = -1;
+      std::shared_ptr<MemoryBuffer> buffer;
+      std::size_t offset = 0;
+      std::size_t size = 0;      // Bytes handed back, tightly packed.
+      std::size_t row_bytes = 0; // Non-zero for images, whose rows may be padded out to `pitch` in the buffer.
+      std::size_t pitch = 0;
+    };
+
+    struct Request {
+      std::int32_t buffer = -1;
+      std::int32_t image = -1;
+      std::size_t offset = 0;
+      std::size_t row_length = 0; // In texels, for images.
+      std::size_t bytes = 0;      // What the copy takes up in the readback buffer.
+      std::shared_ptr<Ticket> ticket;
+    };
+
+    auto enqueue(const BufferRange& src) -> std::shared_ptr<Ticket>;
+    auto next_batch(std::size_t size) -> Batch&;
+    static auto fetch(const Ticket& ticket, void* out) -> void;
+
+    template<typename T>
+    static auto future_of(Ticket& ticket) -> std::future<std::vector<T>> {
+      auto promise = std::make_shared<std::promise<std::vector<T>>>();
+      ticket.fulfil = [promise](Ticket& landed) {
+        auto data = std::vector<T>(landed.size / sizeof(T));
+        ReadbackQueue::fetch(landed, data.data());
+
+        // Let go of the batch before the data's handed over, so it's free for reuse by the time anyone sees it.
+        landed.buffer.reset();
+        promise->set_value(std::move(data));
+      };
+      return promise->get_future();
+    }
+
+    int m_gpu = -1;
+    Queue m_queue = Queue::Graphics;
+    std::vector<Request> m_pending;
+    std::vector<Batch> m_batches;
+};
+}
+}
@@ -33,7 +33,7 @@ namespace gfx {
     LunaAssert(info.gpu >= 0, "Cannot accept a negative gpu value.");
     auto& res = vulkan::global_resources();
     auto& gpu = res.devices[info.gpu];
-    auto index = vulkan::find_valid_entry(res.render_passes);
+    auto index = res.render_passes.acquire();
     res.render_passes[index] = std::move(luna::vulkan::RenderPass(gpu, info));
     this->m_handle = index;
     this->m_info = info;
@@ -43,7 +43,10 @@ namespace gfx {
     if(this->m_handle < 0) return;
 
     auto& res = vulkan::global_resources();
-    auto rp = std::move(res.render_passes[this->m_handle]);
+    {
+      auto rp = std::move(res.render_passes[this->m_handle]);
+    }
+    res.render_passes.release(this->m_handle);
     this->m_handle = -1;
     this->m_info = {};
   }
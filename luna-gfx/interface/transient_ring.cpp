@@ -0,0 +1,102 @@
+#include "luna-gfx/interface/transient_ring.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/vulkan/device.hpp"
+#include "luna-gfx/vulkan/utils/helper_functions.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <algorithm>
+#include <utility>
+namespace luna {
+namespace gfx {
+TransientRing::TransientRing(int gpu, std::size_t size) {
+  auto& limits = vulkan::global_resources().devices[gpu].properties.limits;
+
+  // Every allocation has to be usable as a dynamic offset, and flushable on its own if memory isn't coherent.
+  this->m_alignment = std::max<std::size_t>({1u, limits.minUniformBufferOffsetAlignment,
+                                              limits.minStorageBufferOffsetAlignment, limits.nonCoherentAtomSize});
+  this->m_buffer = MemoryBuffer(gpu, size, MemoryType::Streaming);
+  this->m_buffer.map(&this->m_data);
+}
+
+auto TransientRing::operator=(TransientRing&& mv) -> TransientRing& {
+  this->m_buffer = std::move(mv.m_buffer);
+  this->m_data = mv.m_data;
+  this->m_alignment = mv.m_alignment;
+  this->m_head = mv.m_head;
+  this->m_tail = mv.m_tail;
+  this->m_frames = std::move(mv.m_frames);
+  mv.m_data = nullptr;
+  mv.m_head = 0;
+  mv.m_tail = 0;
+  mv.m_frames.clear();
+  return *this;
+}
+
+auto TransientRing::allocate(std::size_t size) -> Allocation {
+  LunaAssert(this->m_data, "Attempting to allocate from an invalid transient ring.");
+  auto aligned = ((size + this->m_alignment - 1) / this->m_alignment) * this->m_alignment;
+  LunaAssert(aligned < this->capacity(), "Allocation is larger than the entire transient ring.");
+
+  // Out of room means the oldest frames are still in flight, so this is the only place the ring will ever wait.
+  while(!this->fits(aligned)) {
+    LunaAssert(this->retire_oldest(true), "Transient ring is too small to hold a single frame's allocations.");
+  }
+
+  auto offset = this->m_head;
+  this->m_head += aligned;
+  vulkan::mark_buffer_dirty(this->m_buffer.handle(), offset, aligned);
+  return {this->m_data + offset, static_cast<std::uint32_t>(offset), size};
+}
+
+auto TransientRing::next_frame() -> void {
+  auto& res = vulkan::global_resources();
+  auto gpu = this->m_buffer.gpu();
+  this->m_frames.push_back({this->m_head, res.deletion_queues[gpu].last_submitted()});
+
+  // Reclaim whatever the GPU has already finished with.
+  while(this->retire_oldest(false)) {}
+}
+
+auto TransientRing::flush() -> void {
+  this->m_buffer.flush();
+}
+
+auto TransientRing::retire_oldest(bool wait) -> bool {
+  if(this->m_frames.empty()) return false;
+
+  auto& res = vulkan::global_resources();
+  auto gpu = this->m_buffer.gpu();
+  auto& device = res.devices[gpu];
+  auto& queue = res.deletion_queues[gpu];
+  auto& frame = this->m_frames.front();
+  if(!queue.is_complete(device, frame.serial)) {
+    if(!wait) return false;
+    queue.wait(device, frame.serial);
+  }
+
+  this->m_tail = frame.end;
+  this->m_frames.pop_front();
+
+  // Head meeting tail means nothing is live, so start from the front again.
+  if(this->m_tail == this->m_head) {
+    this->m_head = 0;
+    this->m_tail = 0;
+  }
+  return true;
+}
+
+auto TransientRing::fits(std::size_t size) -> bool {
+  if(this->m_head >= this->m_tail) {
+    if(this->m_head + size <= this->capacity()) return true;
+
+    // Wrap around to the front, as long as that doesn't run into the tail. Head may never catch up to the tail,
+    // since head == tail means the ring is empty.
+    if(size < this->m_tail) {
+      this->m_head = 0;
+      return true;
+    }
+    return false;
+  }
+  return this->m_head + size < this->m_tail;
+}
+}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "luna-gfx/interface/buffer.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+
+namespace luna {
+namespace gfx {
+/** Scratch GPU memory for data that only has to live for a frame, like per-draw uniforms.
+ * Every allocation is a pointer bump into one persistently mapped buffer, aligned so that its offset can be used
+ * directly as a dynamic offset when binding (see GraphicsPipelineInfo::dynamic_bindings & CommandList::bind).
+ * The buffer is MemoryType::Streaming, so with ReBAR it's written straight into VRAM. Only write to it, never read.
+ *
+ * Call next_frame() once a frame's work has been submitted. That frame's allocations are recycled once the GPU is
+ * done with everything submitted before then. Only blocks if the ring is too small for the frames in flight.
+ * Not thread-safe: use one ring per recording thread.
+ */
+class TransientRing {
+  public:
+    struct Allocation {
+      void* data = nullptr;     // Mapped memory to write into.
+      std::uint32_t offset = 0; // Offset of this allocation in buffer().
+      std::size_t size = 0;
+    };
+
+    TransientRing(const TransientRing& cpy) = delete;
+    auto operator=(const TransientRing& cpy) -> TransientRing& = delete;
+
+    TransientRing() = default;
+    TransientRing(int gpu, std::size_t size);
+    TransientRing(TransientRing&& mv) {*this = std::move(mv);}
+    ~TransientRing() = default;
+    auto operator=(TransientRing&& mv) -> TransientRing&;
+
+    [[nodiscard]] auto allocate(std::size_t size) -> Allocation;
+
+    // Allocates space for the value and copies it in.
+    template<typename T>
+    [[nodiscard]] auto push(const T& value) -> Allocation {
+      auto alloc = this->allocate(sizeof(T));
+      std::memcpy(alloc.data, &value, sizeof(T));
+      return alloc;
+    }
+
+    // Marks the end of a frame's allocations.
+    auto next_frame() -> void;
+
+    // Makes writes to everything allocated since the last flush visible to the GPU. Only needed if the memory isn't
+    // host coherent.
+    auto flush() -> void;
+
+    [[nodiscard]] inline auto buffer() const -> const MemoryBuffer& {return this->m_buffer;}
+    [[nodiscard]] inline auto alignment() const -> std::size_t {return this->m_alignment;}
+    [[nodiscard]] inline auto capacity() const -> std::size_t {return this->m_buffer.size();}
+
+  private:
+    struct Frame {
+      std::size_t end = 0;
+      std::uint64_t serial = 0;
+    };
+
+    auto retire_oldest(bool wait) -> bool;
+    auto fits(std::size_t size) -> bool;
+
+    MemoryBuffer m_buffer;
+    unsigned char* m_data = nullptr;
+    std::size_t m_alignment = 1;
+    std::size_t m_head = 0;
+    std::size_t m_tail = 0;
+    std::deque<Frame> m_frames;
+};
+}
+}
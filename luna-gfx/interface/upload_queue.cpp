@@ -0,0 +1,138 @@
+#include "luna-gfx/interface/upload_queue.hpp"
+#include "luna-gfx/interface/image.hpp"
+#include "luna-gfx/vulkan/utils/helper_functions.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/common/streaming_copy.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <utility>
+namespace luna {
+namespace gfx {
+UploadQueue::UploadQueue(int gpu) {
+  this->m_gpu = gpu;
+}
+
+UploadQueue::~UploadQueue() {
+  // Anything never submitted never reached the GPU, so its staging memory can go straight back.
+  this->release_pending(0);
+}
+
+auto UploadQueue::operator=(UploadQueue&& mv) -> UploadQueue& {
+  this->release_pending(0);
+  this->m_gpu = mv.m_gpu;
+  this->m_pending = std::move(mv.m_pending);
+  this->m_batches = std::move(mv.m_batches);
+  mv.m_gpu = -1;
+  mv.m_pending.clear();
+  mv.m_batches.clear();
+  return *this;
+}
+
+auto UploadQueue::upload(MemoryBuffer& dst, const void* data, std::size_t size, std::size_t offset) -> std::future<bool> {
+  LunaAssert(offset + size <= dst.size(), "Attempting to upload past the end of a buffer.");
+  auto request = Request();
+  request.buffer = dst.handle();
+  request.offset = offset;
+  return this->stage(data, size, request);
+}
+
+auto UploadQueue::upload(Image& dst, const unsigned char* data) -> std::future<bool> {
+  auto info = dst.info();
+  auto request = Request();
+  request.image = dst.handle();
+  return this->stage(data, info.width * info.height * vulkan::size_from_format(info.format), request);
+}
+
+auto UploadQueue::submit() -> void {
+  if(this->m_pending.empty()) return;
+  auto& res = vulkan::global_resources();
+  auto& device = res.devices[this->m_gpu];
+  auto src_family = device.transfer().id;
+  auto dst_family = device.graphics().id;
+  auto handoff = src_family != dst_family;
+  auto& batch = this->next_batch();
+
+  batch.transfer.begin();
+  for(auto& request : this->m_pending) {
+    auto cmd = batch.transfer.handle();
+    if(request.buffer >= 0) {
+      vulkan::copy_buffer_to_buffer(cmd, request.staging, request.buffer, request.size, request.staging_offset, request.offset);
+      if(handoff) vulkan::buffer_ownership_barrier(cmd, request.buffer, src_family, dst_family, true);
+    } else {
+      vulkan::copy_buffer_to_image(cmd, request.staging, request.image, request.staging_offset);
+      if(handoff) vulkan::image_ownership_barrier(cmd, request.image, src_family, dst_family, true);
+    }
+  }
+  batch.transfer.end();
+
+  // The graphics family has to acquire everything the transfer family released, once the copies are done.
+  if(handoff) {
+    if(batch.acquire.handle() < 0) batch.acquire = CommandList(this->m_gpu, Queue::Graphics);
+    batch.acquire.begin();
+    for(auto& request : this->m_pending) {
+      auto cmd = batch.acquire.handle();
+      if(request.buffer >= 0) vulkan::buffer_ownership_barrier(cmd, request.buffer, src_family, dst_family, false);
+      else vulkan::image_ownership_barrier(cmd, request.image, src_family, dst_family, false);
+    }
+    batch.acquire.end();
+    batch.transfer.combo_into(batch.acquire);
+  }
+
+  // The last submission of the batch finishing means all of it has, so that's the one that fulfils the futures.
+  auto last = handoff ? batch.acquire.handle() : batch.transfer.handle();
+  auto promises = std::vector<std::shared_ptr<std::promise<bool>>>();
+  for(auto& request : this->m_pending) promises.push_back(std::move(request.done));
+  res.cmds[last].on_complete.push_back([promises](bool) {
+    for(auto& promise : promises) promise->set_value(true);
+  });
+
+  vulkan::submit_command_buffer(batch.transfer.handle());
+  if(handoff) vulkan::submit_command_buffer(batch.acquire.handle());
+  batch.serial = res.cmds[last].serial;
+  this->release_pending(batch.serial);
+}
+
+auto UploadQueue::stage(const void* data, std::size_t size, Request request) -> std::future<bool> {
+  LunaAssert(this->m_gpu >= 0, "Attempting to upload through an invalid upload queue.");
+  auto& res = vulkan::global_resources();
+  auto staging = res.staging_pools[this->m_gpu].allocate(this->m_gpu, size);
+  stream_copy(staging.data, data, size);
+  vulkan::flush_buffer_range(staging.buffer, staging.offset, size);
+
+  request.staging = staging.buffer;
+  request.staging_offset = staging.offset;
+  request.size = size;
+  request.done = std::make_shared<std::promise<bool>>();
+  this->m_pending.push_back(request);
+  return request.done->get_future();
+}
+
+auto UploadQueue::next_batch() -> Batch& {
+  auto& res = vulkan::global_resources();
+  auto& device = res.devices[this->m_gpu];
+  auto& queue = res.deletion_queues[this->m_gpu];
+
+  // Reuse the command lists of a batch the GPU is done with, if there is one.
+  for(auto& batch : this->m_batches) {
+    if(queue.is_complete(device, batch.serial)) return batch;
+  }
+
+  auto batch = Batch();
+  batch.transfer = CommandList(this->m_gpu, Queue::Transfer);
+  this->m_batches.push_back(std::move(batch));
+  return this->m_batches.back();
+}
+
+auto UploadQueue::release_pending(std::uint64_t serial) -> void {
+  if(this->m_pending.empty()) return;
+  auto& pool = vulkan::global_resources().staging_pools[this->m_gpu];
+  for(auto& request : this->m_pending) {
+    auto alloc = vulkan::StagingPool::Allocation();
+    alloc.buffer = request.staging;
+    alloc.offset = request.staging_offset;
+    alloc.size = request.size;
+    pool.release(alloc, serial);
+  }
+  this->m_pending.clear();
+}
+}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "luna-gfx/interface/buffer.hpp"
+#include "luna-gfx/interface/command_list.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <vector>
+
+namespace luna {
+namespace gfx {
+class Image;
+
+/** Batches uploads onto the transfer queue, so streaming data never stalls whoever is rendering.
+ * Each upload copies its data into staging memory right away and is recorded when submit() is called, which puts the
+ * whole batch into a single command list on Queue::Transfer & submits it once. If the transfer queue is its own family,
+ * ownership of everything uploaded is handed over to the graphics family as part of the batch.
+ *
+ * Every upload returns a future that the device's completion thread makes ready once its batch has finished on the
+ * GPU. An upload that's never submitted is never made ready, and its future is broken once the queue goes. Record from
+ * one thread per queue, like a CommandList.
+ */
+class UploadQueue {
+  public:
+    UploadQueue(const UploadQueue& cpy) = delete;
+    auto operator=(const UploadQueue& cpy) -> UploadQueue& = delete;
+
+    UploadQueue() = default;
+    explicit UploadQueue(int gpu);
+    UploadQueue(UploadQueue&& mv) {*this = std::move(mv);}
+    ~UploadQueue();
+    auto operator=(UploadQueue&& mv) -> UploadQueue&;
+
+    template<typename T>
+    [[nodiscard]] auto upload(Vector<T>& dst, const T* data) -> std::future<bool> {return this->upload(dst.buffer(), data, dst.size() * sizeof(T));}
+
+    [[nodiscard]] auto upload(MemoryBuffer& dst, const void* data, std::size_t size, std::size_t offset = 0) -> std::future<bool>;
+    [[nodiscard]] auto upload(Image& dst, const unsigned char* data) -> std::future<bool>;
+
+    // Records every pending upload into one command list & submits it.
+    auto submit() -> void;
+
+    [[nodiscard]] inline auto pending() const -> std::size_t {return this->m_pending.size();}
+    [[nodiscard]] inline auto gpu() const -> int {return this->m_gpu;}
+
+  private:
+    struct Request {
+      std::int32_t staging = -1;
+      std::size_t staging_offset = 0;
+      std::size_t size = 0;
+      std::int32_t buffer = -1;
+      std::int32_t image = -1;
+      std::size_t offset = 0;
+      std::shared_ptr<std::promise<bool>> done;
+    };
+
+    struct Batch {
+      CommandList transfer;
+      CommandList acquire; // Only used when ownership has to move to the graphics family.
+      std::uint64_t serial = 0;
+    };
+
+    auto stage(const void* data, std::size_t size, Request request) -> std::future<bool>;
+    auto next_batch() -> Batch&;
+    auto release_pending(std::uint64_t serial) -> void;
+
+    int m_gpu = -1;
+    std::vector<Request> m_pending;
+    std::vector<Batch> m_batches;
+};
+}
+}
@@ -4,6 +4,7 @@
 #include "luna-gfx/vulkan/utils/helper_functions.hpp"
 #include "luna-gfx/vulkan/global_resources.hpp"
 #include "luna-gfx/error/error.hpp"
+#include <mutex>
 #include <utility>
 
 namespace luna {
@@ -12,7 +13,12 @@ Window::Window(WindowInfo info) {
   auto& res = vulkan::global_resources();
   auto img_info = gfx::ImageInfo();
 
-  this->m_handle = vulkan::find_valid_entry(res.windows);
+  {
+    auto lock = std::scoped_lock(res.window_lock);
+    this->m_handle = res.windows.acquire();
+    auto swap_handle = res.swapchains.acquire();
+    LunaAssert(swap_handle == this->m_handle, "Window and swapchain handles have gone out of sync.");
+  }
   auto& swap = res.swapchains[this->m_handle];
 
   res.windows[this->m_handle] = std::move(vulkan::Window(info));
@@ -31,6 +37,13 @@ Window::~Window() {
   {
     auto tmp = std::move(res.windows[this->m_handle]);
   }
+
+  {
+    auto lock = std::scoped_lock(res.window_lock);
+    res.swapchains.release(this->m_handle);
+    res.windows.release(this->m_handle);
+  }
+  this->m_handle = -1;
 }
 
 auto Window::width() -> std::size_t {
@@ -65,6 +78,9 @@ auto Window::present() -> void {
   auto& res = vulkan::global_resources();
   auto& swap = res.swapchains[this->m_handle];
   swap.present();
+
+  // Once a frame is as often as budgets need re-reading.
+  res.memory_budgets[swap.m_gpu].next_frame(swap.m_gpu);
 }
 
 auto Window::current_frame() -> std::size_t {
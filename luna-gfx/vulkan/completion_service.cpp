@@ -0,0 +1,150 @@
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include "luna-gfx/vulkan/completion_service.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/vulkan/device.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <algorithm>
+#include <utility>
+namespace luna {
+namespace vulkan {
+CompletionService::CompletionService(CompletionService&& mv) {
+  *this = std::move(mv);
+}
+
+auto CompletionService::operator=(CompletionService&& mv) -> CompletionService& {
+  // The thread holds on to its service, so only ones that haven't started can move.
+  LunaAssert(!mv.m_thread.joinable() && !this->m_thread.joinable(), "Attempting to move a running completion service.");
+  this->m_watches = std::move(mv.m_watches);
+  this->m_pending = std::move(mv.m_pending);
+  return *this;
+}
+
+auto CompletionService::watch(int gpu, vk::Semaphore timeline, std::uint64_t value, Callback callback) -> void {
+  auto& device = global_resources().devices[gpu];
+  auto lock = std::scoped_lock(this->m_lock);
+  if(!this->m_thread.joinable()) {
+    auto type_info = vk::SemaphoreTypeCreateInfo();
+    type_info.setSemaphoreType(vk::SemaphoreType::eTimeline);
+    auto info = vk::SemaphoreCreateInfo();
+    info.setPNext(&type_info);
+    this->m_wake = error(device.gpu.createSemaphore(info, device.allocate_cb, device.m_dispatch));
+    this->m_wake_value = 0;
+    this->m_quit = false;
+    this->m_thread = std::thread([this, gpu]() {this->run(gpu);});
+  }
+
+  this->m_watches.push_back({timeline, value, std::move(callback)});
+  this->m_pending[timeline][value]++;
+
+  // Submits count up, so most watches come after a point the thread is already waiting on and get picked up once it
+  // wakes. It only has to be woken for ones it would otherwise sleep through.
+  auto waiting = this->m_waiting.find(timeline);
+  if(waiting != this->m_waiting.end() && waiting->second <= value) return;
+  auto signal = vk::SemaphoreSignalInfo();
+  signal.setSemaphore(this->m_wake);
+  signal.setValue(++this->m_wake_value);
+  error(device.gpu.signalSemaphore(signal, device.m_dispatch));
+}
+
+auto CompletionService::settle(vk::Semaphore timeline, std::uint64_t value) -> void {
+  auto lock = std::unique_lock(this->m_lock);
+  if(std::this_thread::get_id() == this->m_thread.get_id()) return;
+  this->m_settled.wait(lock, [&]() {
+    auto pending = this->m_pending.find(timeline);
+    return this->m_quit || pending == this->m_pending.end() || pending->second.begin()->first > value;
+  });
+}
+
+auto CompletionService::stop(int gpu) -> void {
+  if(!this->m_thread.joinable()) return;
+  auto& device = global_resources().devices[gpu];
+  auto thread = std::thread();
+  {
+    // settle() reads the thread's id under the lock, so it's only swapped out under it too.
+    auto lock = std::scoped_lock(this->m_lock);
+    this->m_quit = true;
+    auto signal = vk::SemaphoreSignalInfo();
+    signal.setSemaphore(this->m_wake);
+    signal.setValue(++this->m_wake_value);
+    error(device.gpu.signalSemaphore(signal, device.m_dispatch));
+    thread = std::move(this->m_thread);
+  }
+  thread.join();
+  this->m_waiting.clear();
+  device.gpu.destroy(this->m_wake, device.allocate_cb, device.m_dispatch);
+  this->m_wake = nullptr;
+
+  auto left = std::move(this->m_watches);
+  this->m_watches.clear();
+  for(auto& watch : left) watch.callback();
+  {
+    auto lock = std::scoped_lock(this->m_lock);
+    this->m_pending.clear();
+  }
+  this->m_settled.notify_all();
+}
+
+auto CompletionService::run(int gpu) -> void {
+  auto& device = global_resources().devices[gpu];
+  while(true) {
+    // Wake on whichever comes first: the lowest point waited on for any timeline, or a new watch coming in.
+    auto timelines = std::vector<vk::Semaphore>();
+    auto values = std::vector<std::uint64_t>();
+    {
+      auto lock = std::scoped_lock(this->m_lock);
+      if(this->m_quit) return;
+      auto lowest = std::map<vk::Semaphore, std::uint64_t>();
+      for(auto& watch : this->m_watches) {
+        auto iter = lowest.find(watch.timeline);
+        if(iter == lowest.end()) lowest.emplace(watch.timeline, watch.value);
+        else iter->second = std::min(iter->second, watch.value);
+      }
+
+      this->m_waiting = lowest;
+      timelines.push_back(this->m_wake);
+      values.push_back(this->m_wake_value + 1);
+      for(auto& point : lowest) {
+        timelines.push_back(point.first);
+        values.push_back(point.second);
+      }
+    }
+
+    auto info = vk::SemaphoreWaitInfo();
+    info.setFlags(vk::SemaphoreWaitFlagBits::eAny);
+    info.setSemaphores(timelines);
+    info.setValues(values);
+    error(device.gpu.waitSemaphores(info, UINT64_MAX, device.m_dispatch));
+
+    // Pull out everything that's done, reading each timeline's counter once.
+    auto ready = std::vector<Watch>();
+    {
+      auto lock = std::scoped_lock(this->m_lock);
+      auto counters = std::map<vk::Semaphore, std::uint64_t>();
+      auto remaining = std::vector<Watch>();
+      for(auto& watch : this->m_watches) {
+        auto counter = counters.find(watch.timeline);
+        if(counter == counters.end()) {
+          counter = counters.emplace(watch.timeline, error(device.gpu.getSemaphoreCounterValue(watch.timeline, device.m_dispatch))).first;
+        }
+        if(counter->second >= watch.value) ready.push_back(std::move(watch));
+        else remaining.push_back(std::move(watch));
+      }
+      this->m_watches = std::move(remaining);
+    }
+    if(ready.empty()) continue;
+
+    // Run unlocked, so callbacks can add watches of their own.
+    for(auto& watch : ready) watch.callback();
+    {
+      auto lock = std::scoped_lock(this->m_lock);
+      for(auto& watch : ready) {
+        auto& pending = this->m_pending[watch.timeline];
+        if(--pending[watch.value] == 0) pending.erase(watch.value);
+        if(pending.empty()) this->m_pending.erase(watch.timeline);
+      }
+    }
+    this->m_settled.notify_all();
+  }
+}
+}
+}
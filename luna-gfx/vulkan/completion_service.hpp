@@ -0,0 +1,61 @@
+#pragma once
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include <vulkan/vulkan.hpp>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+namespace luna {
+namespace vulkan {
+/** Runs callbacks once the GPU reaches points on a device's queue timelines, without anyone having to wait for them.
+ * One thread per device blocks in vkWaitSemaphores on every timeline something is waiting on, along with one the host
+ * signals to wake it up whenever a new wait comes in. Callbacks run on that thread in the order they were added, so
+ * they should be quick & never wait on the GPU themselves.
+ * The thread starts with the first watch().
+ */
+class CompletionService {
+  public:
+    using Callback = std::function<void()>;
+    CompletionService() = default;
+    CompletionService(CompletionService&& mv);
+    CompletionService(const CompletionService& cpy) = delete;
+    ~CompletionService() = default;
+    auto operator=(CompletionService&& mv) -> CompletionService&;
+    auto operator=(const CompletionService& cpy) -> CompletionService& = delete;
+
+    // Runs the callback once the timeline reaches the value.
+    auto watch(int gpu, vk::Semaphore timeline, std::uint64_t value, Callback callback) -> void;
+
+    // Blocks until every callback watching the timeline, up to the value, has run. Returns right away when called from
+    // a callback.
+    auto settle(vk::Semaphore timeline, std::uint64_t value) -> void;
+
+    // Stops the thread & runs whatever callbacks are left. Only for when the device is known to be idle.
+    auto stop(int gpu) -> void;
+
+  private:
+    struct Watch {
+      vk::Semaphore timeline;
+      std::uint64_t value = 0;
+      Callback callback;
+    };
+
+    auto run(int gpu) -> void;
+
+    std::mutex m_lock;
+    std::condition_variable m_settled;
+    std::thread m_thread;
+    std::vector<Watch> m_watches;
+    // How many callbacks at each value are still to run, per timeline. Watches can come in out of order when threads
+    // submit to the same queue, so a later value being done says nothing about an earlier one.
+    std::map<vk::Semaphore, std::map<std::uint64_t, std::size_t>> m_pending;
+    std::map<vk::Semaphore, std::uint64_t> m_waiting; // Lowest value the thread last went to sleep on, per timeline.
+    vk::Semaphore m_wake;
+    std::uint64_t m_wake_value = 0;
+    bool m_quit = false;
+};
+}
+}
@@ -1,16 +1,29 @@
 #pragma once 
 #include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include "luna-gfx/interface/buffer.hpp"
 #include "luna-gfx/interface/image.hpp"
 #include <vulkan/vulkan.hpp>
 #include <vk_mem_alloc.h>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <utility>
 #include <vector>
 namespace luna {
 namespace vulkan {
+struct ThreadPool;
+
+// How the host touches a buffer's memory, which decides what kind of memory VMA looks for.
+enum class HostAccess {
+  None,                  // Never mapped. Filled through staging copies.
+  SequentialWrite,       // Written front to back & never read, so write-combined memory is fine.
+  Random,                // Read & written anywhere, so it wants host cached memory.
+  Streaming,             // Written sequentially every frame. Device local with ReBAR, host memory without.
+  DeviceSequentialWrite, // Written sequentially into device local memory with ReBAR, otherwise filled through staging.
+};
 
 struct Semaphore {
   vk::Semaphore sem = {};
-  bool in_use = false;
-  auto valid() const {return in_use;}
 };
 
 struct Buffer {
@@ -18,7 +31,20 @@ struct Buffer {
   VmaAllocation alloc = {};
   VmaAllocationInfo info = {};
   std::size_t size = 0;
+  vk::BufferUsageFlags usage = {};
   int gpu = -1;
+  gfx::MemoryType type = gfx::MemoryType::Unknown; // What its memory gets counted as in the gpu's MemoryBudget.
+
+  // Host-visible buffers stay mapped for their whole lifetime.
+  void* mapped = nullptr;
+  bool coherent = true;
+
+  // Non-zero once the buffer's device address has been handed out.
+  vk::DeviceAddress address = 0;
+
+  // Sorted, non-overlapping [begin, end) byte ranges written through the mapping that haven't been flushed yet.
+  // Only tracked if the memory isn't coherent.
+  std::vector<std::pair<std::size_t, std::size_t>> dirty;
   auto valid() const -> bool {return this->buffer;}
 };
 
@@ -34,8 +60,11 @@ struct Image {
   std::size_t layer = 0;
   vk::ImageLayout layout = {};
   VmaAllocation alloc = {};
+  vk::ImageCreateInfo create_info = {}; // Kept so that defragmentation can remake the image elsewhere.
   gfx::ImageInfo info = {};
   bool imported = false;
+  bool attachment = false; // Framebuffers hold on to its view, so its memory is never moved.
+  std::atomic<std::uint64_t> last_use = {0}; // Deletion queue serial of the last submit that used it.
 
   auto valid() const -> bool {return this->image;}
 };
@@ -43,18 +72,43 @@ struct Image {
 struct CommandBuffer {
   vk::CommandBuffer cmd = {};
   vk::CommandBufferBeginInfo begin_info = {};
-  std::vector<int32_t> sems_to_wait_on = {};
+  std::vector<int32_t> sems_to_wait_on = {}; // Binary semaphores, only used to sync with swapchains.
   std::vector<int32_t> sems_to_signal = {};
-  vk::SubmitInfo submit_info = {};
-  vk::Fence fence = {};
+
+  // Points on queue timelines the next submit waits on. Lists combo'd into this one add theirs when they're submitted,
+  // since a point isn't known until then.
+  std::vector<std::pair<vk::Semaphore, std::uint64_t>> timeline_waits = {};
+  std::vector<int32_t> combos = {}; // Lists waiting on this one's next submit.
+  std::size_t pending_combos = 0;   // Lists combo'd into this one that haven't been submitted yet.
+  vk::Semaphore timeline = {}; // The timeline of the queue this is submitted to.
+  std::uint64_t point = 0;     // The value the last submit signals it to.
   vk::Queue queue = {};
   vk::CommandPool pool = {};
   vk::QueryPool timestamp_pool = {};
   int gpu = -1;
-  int32_t rp_id = -1;
+  int32_t rp_id = -1;       // The render pass being recorded, if any.
+  std::size_t framebuffer = 0;
+  std::uint32_t subpass = 0;
+  // Deletion queue serial of the last submission. For secondaries, the last one to run them, guarded by the queue's lock.
+  std::uint64_t serial = 0;
+
+  // The layout of the last pipeline bound, which push constants are recorded against.
+  vk::PipelineLayout layout = {};
+  vk::ShaderStageFlags push_stages = {};
+  std::size_t push_size = 0;
   
-  CommandBuffer* parent = nullptr;
-  bool signaled = false;
+  int32_t parent = -1;                // Set for secondaries. They inherit its render pass when they begin.
+  std::vector<int32_t> executed = {}; // Secondaries run by this list since it began.
+  std::vector<int32_t> images = {};   // Images used since it began, which every submit marks as in use.
+  // The creating thread's pool. Null for lists from transient pools, which are reset & destroyed as a whole.
+  std::shared_ptr<ThreadPool> thread_pool = {};
+  bool signaled = false;              // Submitted, and not waited on since.
+  bool recording = false;             // Begun & not ended yet. Keeps the defragmenter from swapping objects out.
+
+  // Run on the completion thread with true once the next submit finishes, handed off to it on submit. Run right away
+  // with false if the list is destroyed before then, so nothing waiting on them is left hanging.
+  std::vector<std::function<void(bool)>> on_complete = {};
+  bool awaiting_callbacks = false; // The last submit's callbacks may not have run yet.
   auto valid() const -> bool {return this->cmd;}
 };
 }
@@ -0,0 +1,368 @@
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include "luna-gfx/vulkan/defragmenter.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/vulkan/data_types.hpp"
+#include "luna-gfx/vulkan/descriptor.hpp"
+#include "luna-gfx/vulkan/utils/helper_functions.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <algorithm>
+#include <array>
+#include <utility>
+#include <vector>
+namespace luna {
+namespace vulkan {
+// Keeps a single pass short enough to fit in a frame's budget.
+constexpr auto cMaxBytesPerPass = VkDeviceSize(32) * 1024 * 1024;
+constexpr auto cMaxMovesPerPass = 64u;
+
+inline auto aspect_of(const Image& image) -> vk::ImageAspectFlags {
+  if(image.format == vk::Format::eD24UnormS8Uint) return vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil;
+  return vk::ImageAspectFlagBits::eColor;
+}
+
+inline auto layout_barrier(const Image& image, vk::Image target, vk::ImageLayout from, vk::ImageLayout to) -> vk::ImageMemoryBarrier {
+  auto range = vk::ImageSubresourceRange();
+  range.setAspectMask(aspect_of(image));
+  range.setBaseArrayLayer(0);
+  range.setBaseMipLevel(0);
+  range.setLevelCount(image.create_info.mipLevels);
+  range.setLayerCount(image.create_info.arrayLayers);
+
+  auto barrier = vk::ImageMemoryBarrier();
+  barrier.setImage(target);
+  barrier.setOldLayout(from);
+  barrier.setNewLayout(to);
+  barrier.setSubresourceRange(range);
+  barrier.setSrcQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+  barrier.setDstQueueFamilyIndex(VK_QUEUE_FAMILY_IGNORED);
+  barrier.setSrcAccessMask(vk::AccessFlagBits::eMemoryWrite);
+  barrier.setDstAccessMask(vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+  return barrier;
+}
+
+inline auto record_image_copy(vk::CommandBuffer cmd, Device& device, Image& image, vk::Image target) -> void {
+  const auto all = vk::PipelineStageFlags(vk::PipelineStageFlagBits::eAllCommands);
+  const auto transfer = vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTransfer);
+  auto layout = image.layout == vk::ImageLayout::eUndefined ? vk::ImageLayout::eGeneral : image.layout;
+
+  auto before = std::array<vk::ImageMemoryBarrier, 2>{
+    layout_barrier(image, image.image, image.layout, vk::ImageLayout::eTransferSrcOptimal),
+    layout_barrier(image, target, vk::ImageLayout::eUndefined, vk::ImageLayout::eTransferDstOptimal),
+  };
+  cmd.pipelineBarrier(all, transfer, vk::DependencyFlags(), 0, nullptr, 0, nullptr, before.size(), before.data(), device.m_dispatch);
+
+  auto regions = std::vector<vk::ImageCopy>(image.create_info.mipLevels);
+  for(auto mip = 0u; mip < regions.size(); mip++) {
+    auto layers = vk::ImageSubresourceLayers(aspect_of(image), mip, 0, image.create_info.arrayLayers);
+    auto extent = image.create_info.extent;
+    extent.width = std::max(extent.width >> mip, 1u);
+    extent.height = std::max(extent.height >> mip, 1u);
+    regions[mip].setSrcSubresource(layers);
+    regions[mip].setDstSubresource(layers);
+    regions[mip].setExtent(extent);
+  }
+  cmd.copyImage(image.image, vk::ImageLayout::eTransferSrcOptimal, target, vk::ImageLayout::eTransferDstOptimal,
+                regions.size(), regions.data(), device.m_dispatch);
+
+  // The old image goes back too, in case the pass is cancelled before the new one is swapped in.
+  auto after = std::array<vk::ImageMemoryBarrier, 2>{
+    layout_barrier(image, image.image, vk::ImageLayout::eTransferSrcOptimal, layout),
+    layout_barrier(image, target, vk::ImageLayout::eTransferDstOptimal, layout),
+  };
+  cmd.pipelineBarrier(transfer, all, vk::DependencyFlags(), 0, nullptr, 0, nullptr, after.size(), after.data(), device.m_dispatch);
+  image.layout = layout;
+}
+
+// Destroys whichever of a move's objects are set.
+inline auto destroy_objects(Device& device, vk::Buffer buffer, vk::Image image, vk::ImageView view) -> void {
+  if(view) device.gpu.destroy(view, device.allocate_cb, device.m_dispatch);
+  if(image) device.gpu.destroy(image, device.allocate_cb, device.m_dispatch);
+  if(buffer) device.gpu.destroy(buffer, device.allocate_cb, device.m_dispatch);
+}
+
+Defragmenter::Defragmenter(Defragmenter&& mv) {
+  *this = std::move(mv);
+}
+
+auto Defragmenter::operator=(Defragmenter&& mv) -> Defragmenter& {
+  auto lock = std::scoped_lock(this->m_lock, mv.m_lock, this->m_swap_lock, mv.m_swap_lock);
+  this->m_context = mv.m_context;
+  this->m_targets = std::move(mv.m_targets);
+  this->m_pass = mv.m_pass;
+  this->m_moves = std::move(mv.m_moves);
+  this->m_serial = mv.m_serial;
+  this->m_open = mv.m_open;
+  this->m_swapped = mv.m_swapped;
+  this->m_recording = mv.m_recording;
+  this->m_copy = mv.m_copy;
+  mv.m_context = nullptr;
+  mv.m_pass = {};
+  mv.m_open = false;
+  mv.m_swapped = false;
+  mv.m_recording = 0;
+  mv.m_copy = {};
+  return *this;
+}
+
+auto Defragmenter::step(int gpu, std::chrono::microseconds budget) -> gfx::DefragmentStats {
+  auto& res = global_resources();
+  auto stats = gfx::DefragmentStats();
+  auto start = std::chrono::steady_clock::now();
+  if(!res.allocators[gpu]) {
+    stats.finished = true;
+    return stats;
+  }
+
+  auto lock = std::scoped_lock(this->m_lock);
+  if(!this->m_context) {
+    // A fresh run. The default pools get compacted first, so they go last.
+    this->m_targets = res.memory_pools[gpu].defragmentable();
+    this->m_targets.push_back(nullptr);
+    if(!this->begin(gpu)) {
+      stats.finished = true;
+      return stats;
+    }
+  }
+
+  auto& queue = res.deletion_queues[gpu];
+  while(!stats.finished && std::chrono::steady_clock::now() - start < budget) {
+    if(!this->m_open) {
+      if(!this->pass(gpu, stats)) continue;
+    } else {
+      // Come back next frame rather than wait on lists being recorded, or block on the copies.
+      if(!this->m_swapped && !this->swap(gpu)) break;
+      if(!queue.is_complete(res.devices[gpu], this->m_serial)) break;
+      if(!this->finish(gpu)) continue;
+    }
+
+    // This pool's as compact as it gets, move on to the next.
+    vmaEndDefragmentation(res.allocators[gpu], this->m_context, nullptr);
+    this->m_context = nullptr;
+    this->m_targets.pop_back();
+    stats.finished = !this->begin(gpu);
+  }
+
+  return stats;
+}
+
+auto Defragmenter::cancel(int gpu) -> void {
+  auto& res = global_resources();
+  auto lock = std::scoped_lock(this->m_lock);
+  this->m_targets.clear();
+  if(!this->m_context) return;
+  if(this->m_open) {
+    res.deletion_queues[gpu].wait(res.devices[gpu], this->m_serial);
+    this->finish(gpu);
+  }
+  vmaEndDefragmentation(res.allocators[gpu], this->m_context, nullptr);
+  this->m_context = nullptr;
+}
+
+auto Defragmenter::abandon(std::int32_t handle, bool image) -> bool {
+  auto lock = std::scoped_lock(this->m_lock);
+  if(!this->m_open) return false;
+  for(auto& move : this->m_moves) {
+    if(move.handle != handle || move.image != image || move.abandoned) continue;
+    move.abandoned = true;
+    return true;
+  }
+  return false;
+}
+
+auto Defragmenter::began_recording() -> void {
+  auto swap_lock = std::scoped_lock(this->m_swap_lock);
+  this->m_recording++;
+}
+
+auto Defragmenter::ended_recording() -> void {
+  auto swap_lock = std::scoped_lock(this->m_swap_lock);
+  this->m_recording--;
+}
+
+auto Defragmenter::pending_copy() -> std::pair<vk::Semaphore, std::uint64_t> {
+  auto swap_lock = std::scoped_lock(this->m_swap_lock);
+  return this->m_copy;
+}
+
+auto Defragmenter::begin(int gpu) -> bool {
+  auto& res = global_resources();
+  while(!this->m_targets.empty()) {
+    auto info = VmaDefragmentationInfo{};
+    info.pool = this->m_targets.back();
+    info.maxBytesPerPass = cMaxBytesPerPass;
+    info.maxAllocationsPerPass = cMaxMovesPerPass;
+    if(vmaBeginDefragmentation(res.allocators[gpu], &info, &this->m_context) == VK_SUCCESS) return true;
+    this->m_context = nullptr;
+    this->m_targets.pop_back();
+  }
+  return false;
+}
+
+auto Defragmenter::pass(int gpu, gfx::DefragmentStats& stats) -> bool {
+  auto& res = global_resources();
+  auto& device = res.devices[gpu];
+  auto allocator = res.allocators[gpu];
+  this->m_pass = VmaDefragmentationPassMoveInfo{};
+  this->m_moves.clear();
+  this->m_serial = 0;
+  this->m_swapped = false;
+  if(vmaBeginDefragmentationPass(allocator, this->m_context, &this->m_pass) == VK_SUCCESS) return true;
+  this->m_open = true;
+
+  // Make every move's new object & bind it to the memory it's moving into. Anything that can't move is skipped, but
+  // still tracked so that destroying it mid-pass can be handed back to VMA.
+  for(auto index = 0u; index < this->m_pass.moveCount; index++) {
+    auto& move = this->m_pass.pMoves[index];
+    auto alloc_info = VmaAllocationInfo();
+    vmaGetAllocationInfo(allocator, move.srcAllocation, &alloc_info);
+    auto tag = reinterpret_cast<std::uintptr_t>(alloc_info.pUserData);
+    auto next = Move();
+    next.handle = static_cast<std::int32_t>(tag >> 1) - 1;
+    next.image = (tag & 1u) != 0;
+    next.index = index;
+    move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+    if(next.handle < 0) continue;
+
+    if(next.image) {
+      auto& image = res.images[next.handle];
+      next.old_image = image.image;
+      next.old_view = image.view;
+      if(!image.attachment && !image.imported) {
+        next.new_image = error(device.gpu.createImage(image.create_info, device.allocate_cb, device.m_dispatch));
+        vmaBindImageMemory(allocator, move.dstTmpAllocation, static_cast<VkImage>(next.new_image));
+        next.copied = true;
+      }
+    } else {
+      auto& buffer = res.buffers[next.handle];
+      next.old_buffer = buffer.buffer;
+
+      // Shaders may hold a pointer to a buffer once its address is out, so those stay put too.
+      if(!buffer.mapped && !buffer.address) {
+        auto info = vk::BufferCreateInfo();
+        info.setSize(buffer.size);
+        info.setUsage(buffer.usage);
+        next.new_buffer = error(device.gpu.createBuffer(info, device.allocate_cb, device.m_dispatch));
+        vmaBindBufferMemory(allocator, move.dstTmpAllocation, static_cast<VkBuffer>(next.new_buffer));
+        next.copied = true;
+      }
+    }
+
+    if(next.copied) {
+      move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY;
+      stats.bytes_moved += alloc_info.size;
+      stats.allocations_moved++;
+    }
+    this->m_moves.push_back(next);
+  }
+
+  auto copies = std::count_if(this->m_moves.begin(), this->m_moves.end(), [](const Move& move) {return move.copied;});
+  if(copies == 0) return false;
+
+  // The copies wait on the GPU for everything already submitted to any queue, which could still be writing to what's
+  // moving. Nothing on the CPU waits for them.
+  auto cmd_id = res.staging_pools[gpu].command_buffer(gpu);
+  auto& cmd = res.cmds[cmd_id];
+  begin_command_buffer(cmd_id);
+  auto barrier = vk::MemoryBarrier(vk::AccessFlagBits::eMemoryWrite, vk::AccessFlagBits::eTransferRead);
+  cmd.cmd.pipelineBarrier(vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlagBits::eTransfer, vk::DependencyFlags(), 1, &barrier, 0, nullptr, 0, nullptr, device.m_dispatch);
+  for(auto& move : this->m_moves) {
+    if(!move.copied) continue;
+    if(move.image) {
+      record_image_copy(cmd.cmd, device, res.images[move.handle], move.new_image);
+    } else {
+      auto region = vk::BufferCopy(0, 0, res.buffers[move.handle].size);
+      cmd.cmd.copyBuffer(move.old_buffer, move.new_buffer, 1, &region, device.m_dispatch);
+    }
+  }
+  auto after = vk::MemoryBarrier(vk::AccessFlagBits::eTransferWrite, vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+  cmd.cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eAllCommands, vk::DependencyFlags(), 1, &after, 0, nullptr, 0, nullptr, device.m_dispatch);
+  end_command_buffer(cmd_id);
+
+  auto waited = std::vector<const Queue*>();
+  for(auto& queue : device.queues) {
+    auto& owner = device.queue_owner(queue.queue);
+    if(!owner.timeline || std::find(waited.begin(), waited.end(), &owner) != waited.end()) continue;
+    auto owner_lock = std::scoped_lock(owner.lock);
+    if(owner.value) cmd.timeline_waits.push_back({owner.timeline, owner.value});
+    waited.push_back(&owner);
+  }
+  submit_command_buffer(cmd_id);
+  this->m_serial = res.cmds[cmd_id].serial;
+
+  // Other queues only see the copies' writes by waiting on them.
+  auto swap_lock = std::scoped_lock(this->m_swap_lock);
+  this->m_copy = {res.cmds[cmd_id].timeline, res.cmds[cmd_id].point};
+  return false;
+}
+
+auto Defragmenter::swap(int gpu) -> bool {
+  auto& res = global_resources();
+  auto& device = res.devices[gpu];
+  auto swap_lock = std::scoped_lock(this->m_swap_lock);
+  if(this->m_recording > 0) return false;
+
+  // Nothing begins recording until the new objects are in & every descriptor points at them. Moves destroyed since the
+  // pass began have already let go of their handles, so they're left to finish().
+  auto descriptor_lock = std::scoped_lock(res.descriptor_lock);
+  auto buffers = std::vector<std::int32_t>();
+  auto images = std::vector<std::int32_t>();
+  for(auto& move : this->m_moves) {
+    if(!move.copied || move.abandoned) continue;
+    if(move.image) {
+      auto& image = res.images[move.handle];
+      image.image = move.new_image;
+      create_image_view(device, image);
+      move.new_view = image.view;
+      images.push_back(move.handle);
+    } else {
+      res.buffers[move.handle].buffer = move.new_buffer;
+      buffers.push_back(move.handle);
+    }
+  }
+
+  if(!buffers.empty() || !images.empty()) {
+    res.descriptors.for_each([&](std::int32_t, Descriptor& desc) {
+      desc.rebind(buffers, images);
+    });
+  }
+  this->m_swapped = true;
+  return true;
+}
+
+auto Defragmenter::finish(int gpu) -> bool {
+  auto& res = global_resources();
+  auto& device = res.devices[gpu];
+  auto allocator = res.allocators[gpu];
+
+  // The copies are done, so the old objects can go. Whatever was destroyed mid-pass loses both its old & new
+  // objects, and VMA frees its memory. A pass cancelled before the swap keeps everything where it was.
+  for(auto& move : this->m_moves) {
+    if(move.abandoned) {
+      destroy_objects(device, move.old_buffer, move.old_image, move.old_view);
+      destroy_objects(device, move.new_buffer, move.new_image, move.new_view);
+      this->m_pass.pMoves[move.index].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+    } else if(move.copied && this->m_swapped) {
+      destroy_objects(device, move.old_buffer, move.old_image, move.old_view);
+    } else if(move.copied) {
+      destroy_objects(device, move.new_buffer, move.new_image, move.new_view);
+      this->m_pass.pMoves[move.index].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+    }
+  }
+
+  auto result = vmaEndDefragmentationPass(allocator, this->m_context, &this->m_pass);
+  for(auto& move : this->m_moves) {
+    if(move.image || !move.copied || move.abandoned || !this->m_swapped) continue;
+    auto& buffer = res.buffers[move.handle];
+    vmaGetAllocationInfo(allocator, buffer.alloc, &buffer.info);
+  }
+
+  this->m_moves.clear();
+  this->m_pass = {};
+  this->m_open = false;
+  this->m_swapped = false;
+  auto swap_lock = std::scoped_lock(this->m_swap_lock);
+  this->m_copy = {};
+  return result == VK_SUCCESS;
+}
+}
+}
@@ -0,0 +1,96 @@
+#pragma once
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include "luna-gfx/interface/device.hpp"
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+namespace luna {
+namespace vulkan {
+// VMA allocations carry the handle they were made for, so that a move can be traced back to its buffer or image.
+inline auto allocation_tag(std::int32_t handle, bool image) -> void* {
+  return reinterpret_cast<void*>((static_cast<std::uintptr_t>(handle + 1) << 1) | (image ? 1u : 0u));
+}
+
+/** Compacts a device's memory a few allocations at a time using VMA's defragmentation.
+ * Each pass remakes the moved buffers & images in their new memory & submits the copies over (waiting on every queue's
+ * work so far on the GPU, not the CPU). Once no command list on the device is being recorded, it swaps the new objects
+ * in under the same handles & rewrites every descriptor that referred to them. Every submit from then until the pass
+ * ends waits on the copies. The old objects & memory are only let go once the copies have finished, which a later
+ * step() checks for without blocking. Host-visible buffers (whose mappings the app may hold on to) and framebuffer
+ * attachments are left where they are.
+ * The allocator's default pools are compacted first, then each custom pool in turn.
+ */
+class Defragmenter {
+  public:
+    Defragmenter() = default;
+    Defragmenter(Defragmenter&& mv);
+    Defragmenter(const Defragmenter& cpy) = delete;
+    ~Defragmenter() = default;
+    auto operator=(Defragmenter&& mv) -> Defragmenter&;
+    auto operator=(const Defragmenter& cpy) -> Defragmenter& = delete;
+
+    // Runs passes until the budget is spent or there's nothing left to move. Returns early, without blocking, while
+    // the last pass's copies are still running on the GPU.
+    auto step(int gpu, std::chrono::microseconds budget) -> gfx::DefragmentStats;
+
+    // Gives up on a defragmentation in progress, after waiting out the pass in flight. Whatever was swapped in stays
+    // moved.
+    auto cancel(int gpu) -> void;
+
+    // Called when a buffer or image is destroyed. Returns true if it's part of the open pass, in which case the
+    // defragmenter owns its objects & memory from then on and frees them when the pass ends.
+    auto abandon(std::int32_t handle, bool image) -> bool;
+
+    // Called as command lists begin & end recording, since they look up buffers & images by handle as they go.
+    auto began_recording() -> void;
+    auto ended_recording() -> void;
+
+    // The timeline point of the open pass's copies, for submits to wait on. Null when there's nothing to wait on.
+    auto pending_copy() -> std::pair<vk::Semaphore, std::uint64_t>;
+
+  private:
+    // One allocation of the open pass. The old objects stay alive until the copies out of them are done.
+    struct Move {
+      std::int32_t handle = -1;
+      bool image = false;
+      std::uint32_t index = 0; // Into the pass's moves.
+      bool copied = false;     // Whether new objects were made & swapped in, rather than the move being skipped.
+      bool abandoned = false;  // Its handle was destroyed mid-pass.
+      vk::Buffer old_buffer = {};
+      vk::Buffer new_buffer = {};
+      vk::Image old_image = {};
+      vk::Image new_image = {};
+      vk::ImageView old_view = {};
+      vk::ImageView new_view = {};
+    };
+
+    auto begin(int gpu) -> bool;
+    // Both return true once the pool has nothing left to move.
+    auto pass(int gpu, gfx::DefragmentStats& stats) -> bool;
+    auto finish(int gpu) -> bool;
+
+    // Swaps the open pass's new objects in. Returns false, without swapping, while lists are still being recorded.
+    auto swap(int gpu) -> bool;
+
+    // Recursive, since submitting the copies collects the deletion queue, which may destroy a buffer being moved.
+    std::recursive_mutex m_lock;
+    VmaDefragmentationContext m_context = nullptr;
+    std::vector<VmaPool> m_targets; // Pools still to go, the one being compacted last. Null for the default pools.
+    VmaDefragmentationPassMoveInfo m_pass = {};
+    std::vector<Move> m_moves;
+    std::uint64_t m_serial = 0; // The copies' submission.
+    bool m_open = false;        // A pass has begun & hasn't ended yet.
+    bool m_swapped = false;     // The open pass's new objects are in use.
+
+    // Guards what recording & submitting lists check, so they never wait on a pass in progress.
+    std::mutex m_swap_lock;
+    std::size_t m_recording = 0;
+    std::pair<vk::Semaphore, std::uint64_t> m_copy = {};
+};
+}
+}
@@ -0,0 +1,141 @@
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include "luna-gfx/vulkan/deletion_queue.hpp"
+#include "luna-gfx/vulkan/device.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <algorithm>
+#include <iterator>
+#include <utility>
+namespace luna {
+namespace vulkan {
+DeletionQueue::DeletionQueue(DeletionQueue&& mv) {
+  *this = std::move(mv);
+}
+
+auto DeletionQueue::operator=(DeletionQueue&& mv) -> DeletionQueue& {
+  this->m_in_flight = std::move(mv.m_in_flight);
+  this->m_pending = std::move(mv.m_pending);
+  this->m_last_submitted = mv.m_last_submitted;
+  mv.m_last_submitted = 0;
+  return *this;
+}
+
+auto DeletionQueue::submitted(vk::Semaphore timeline, std::uint64_t value) -> std::uint64_t {
+  auto lock = std::scoped_lock(this->m_lock);
+  auto serial = ++this->m_last_submitted;
+  this->m_in_flight[serial] = {timeline, value};
+  return serial;
+}
+
+auto DeletionQueue::defer(Deleter deleter) -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  this->m_pending.emplace_back(this->m_last_submitted, std::move(deleter));
+}
+
+auto DeletionQueue::defer(std::uint64_t serial, Deleter deleter) -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  this->m_pending.emplace_back(serial, std::move(deleter));
+}
+
+auto DeletionQueue::collect(Device& device) -> void {
+  auto ready = std::vector<Deleter>();
+  {
+    auto lock = std::scoped_lock(this->m_lock);
+    this->poll(device);
+
+    auto done = this->completed();
+    auto remaining = std::vector<std::pair<std::uint64_t, Deleter>>();
+    for(auto& pending : this->m_pending) {
+      if(pending.first <= done) ready.push_back(std::move(pending.second));
+      else remaining.push_back(std::move(pending));
+    }
+    this->m_pending = std::move(remaining);
+  }
+
+  // Deleters can call back into this queue (e.g. destroying a command buffer retires it), so run them unlocked.
+  this->run(ready);
+}
+
+auto DeletionQueue::flush() -> void {
+  auto ready = std::vector<Deleter>();
+  {
+    auto lock = std::scoped_lock(this->m_lock);
+    this->m_in_flight.clear();
+    for(auto& pending : this->m_pending) ready.push_back(std::move(pending.second));
+    this->m_pending.clear();
+  }
+  this->run(ready);
+}
+
+auto DeletionQueue::is_complete(Device& device, std::uint64_t serial) -> bool {
+  auto lock = std::scoped_lock(this->m_lock);
+  this->poll(device);
+  return serial <= this->completed();
+}
+
+auto DeletionQueue::wait(Device& device, std::uint64_t serial) -> void {
+  // Timelines only ever count up, so it's enough to wait on the highest value each one has to reach.
+  auto values = std::map<vk::Semaphore, std::uint64_t>();
+  {
+    auto lock = std::scoped_lock(this->m_lock);
+    for(auto& in_flight : this->m_in_flight) {
+      if(in_flight.first > serial) break;
+      auto& value = values[in_flight.second.first];
+      value = std::max(value, in_flight.second.second);
+    }
+  }
+
+  // Nothing here gets reset or destroyed, so other threads can keep submitting & polling while this one waits.
+  if(!values.empty()) {
+    auto timelines = std::vector<vk::Semaphore>();
+    auto points = std::vector<std::uint64_t>();
+    for(auto& value : values) {
+      timelines.push_back(value.first);
+      points.push_back(value.second);
+    }
+    auto info = vk::SemaphoreWaitInfo();
+    info.setSemaphores(timelines);
+    info.setValues(points);
+    error(device.gpu.waitSemaphores(info, UINT64_MAX, device.m_dispatch));
+  }
+
+  auto lock = std::scoped_lock(this->m_lock);
+  this->m_in_flight.erase(this->m_in_flight.begin(), this->m_in_flight.upper_bound(serial));
+}
+
+auto DeletionQueue::last_submitted() const -> std::uint64_t {
+  auto lock = std::scoped_lock(this->m_lock);
+  return this->m_last_submitted;
+}
+
+auto DeletionQueue::pending() const -> std::size_t {
+  auto lock = std::scoped_lock(this->m_lock);
+  return this->m_pending.size();
+}
+
+// Must be called with the lock held.
+auto DeletionQueue::poll(Device& device) -> void {
+  // Only read each timeline's counter once, however many submissions are waiting on it.
+  auto counters = std::map<vk::Semaphore, std::uint64_t>();
+  for(auto iter = this->m_in_flight.begin(); iter != this->m_in_flight.end();) {
+    auto timeline = iter->second.first;
+    auto counter = counters.find(timeline);
+    if(counter == counters.end()) {
+      counter = counters.emplace(timeline, error(device.gpu.getSemaphoreCounterValue(timeline, device.m_dispatch))).first;
+    }
+    iter = counter->second >= iter->second.second ? this->m_in_flight.erase(iter) : std::next(iter);
+  }
+}
+
+auto DeletionQueue::completed() const -> std::uint64_t {
+  // Everything older than the oldest submission still in flight has finished.
+  if(this->m_in_flight.empty()) return this->m_last_submitted;
+  return this->m_in_flight.begin()->first - 1;
+}
+
+auto DeletionQueue::run(std::vector<Deleter>& deleters) -> void {
+  for(auto& deleter : deleters) {
+    if(deleter) deleter();
+  }
+}
+}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include <vulkan/vulkan.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+namespace luna {
+namespace vulkan {
+struct Device;
+
+/** Holds on to destroyed objects until the GPU is done with them.
+ * Every submission to a device gets a serial number. Destroying an object queues its deleter tagged with the most
+ * recent serial that could have used it, and the deleter only runs once every submission up to that serial retired.
+ * Retirement is found by polling the queues' timeline semaphores, so nothing in here ever blocks on the GPU.
+ */
+class DeletionQueue {
+  public:
+    using Deleter = std::function<void()>;
+    DeletionQueue() = default;
+    DeletionQueue(DeletionQueue&& mv);
+    DeletionQueue(const DeletionQueue& cpy) = delete;
+    ~DeletionQueue() = default;
+    auto operator=(DeletionQueue&& mv) -> DeletionQueue&;
+    auto operator=(const DeletionQueue& cpy) -> DeletionQueue& = delete;
+
+    // Records a submission that will signal the timeline semaphore to `value`, and returns its serial.
+    auto submitted(vk::Semaphore timeline, std::uint64_t value) -> std::uint64_t;
+
+    // Queues a deleter to run once everything submitted so far has finished.
+    auto defer(Deleter deleter) -> void;
+
+    // Queues a deleter to run once everything up to the given submission has finished.
+    auto defer(std::uint64_t serial, Deleter deleter) -> void;
+
+    // Polls in-flight submissions and runs every deleter that is safe to run.
+    auto collect(Device& device) -> void;
+
+    // Runs every deleter, finished or not. Only for when the device is known to be idle.
+    auto flush() -> void;
+
+    // Whether every submission up to the given one has finished. Polls, never blocks.
+    [[nodiscard]] auto is_complete(Device& device, std::uint64_t serial) -> bool;
+
+    // Blocks until every submission up to the given one has finished.
+    auto wait(Device& device, std::uint64_t serial) -> void;
+
+    [[nodiscard]] auto last_submitted() const -> std::uint64_t;
+    [[nodiscard]] auto pending() const -> std::size_t;
+
+  private:
+    auto completed() const -> std::uint64_t;
+    auto poll(Device& device) -> void;
+    auto run(std::vector<Deleter>& deleters) -> void;
+
+    mutable std::mutex m_lock;
+    std::map<std::uint64_t, std::pair<vk::Semaphore, std::uint64_t>> m_in_flight;
+    std::vector<std::pair<std::uint64_t, Deleter>> m_pending;
+    std::uint64_t m_last_submitted = 0;
+};
+}
+}
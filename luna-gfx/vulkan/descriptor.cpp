@@ -4,6 +4,7 @@
 #include "luna-gfx/vulkan/pipeline.hpp"
 #include "luna-gfx/vulkan/global_resources.hpp"
 #include <vulkan/vulkan.hpp>
+#include <algorithm>
 #include <iostream>
 #include <utility>
 #include <vector>
@@ -21,6 +22,10 @@ auto convert(gfx::VariableType type) -> vk::DescriptorType {
       return vk::DescriptorType::eUniformBuffer;
     case gfx::VariableType::Storage:
       return vk::DescriptorType::eStorageBuffer;
+    case gfx::VariableType::UniformDynamic:
+      return vk::DescriptorType::eUniformBufferDynamic;
+    case gfx::VariableType::StorateDynamic:
+      return vk::DescriptorType::eStorageBufferDynamic;
     default:
       return vk::DescriptorType::eUniformBuffer;
   }
@@ -28,6 +33,7 @@ auto convert(gfx::VariableType type) -> vk::DescriptorType {
 
 DescriptorPool::DescriptorPool() {
   this->m_map = std::make_shared<UniformMap>();
+  this->m_lock = std::make_shared<std::mutex>();
   this->m_amount = 20;
   this->m_pool = nullptr;
   this->m_pipeline = nullptr;
@@ -61,6 +67,7 @@ auto DescriptorPool::operator=(DescriptorPool&& mv) -> DescriptorPool& {
   mv.m_amount = 20;
 
   this->m_map = std::move(mv.m_map);
+  this->m_lock = std::move(mv.m_lock);
   return *this;
 }
 
@@ -131,6 +138,7 @@ auto Descriptor::operator=(Descriptor&& mv) -> Descriptor& {
   this->m_parent_map = std::move(mv.m_parent_map);
   this->m_pipeline = mv.m_pipeline;
   this->m_set = mv.m_set;
+  this->m_bindings = std::move(mv.m_bindings);
 
   mv.m_set = nullptr;
   mv.m_device = nullptr;
@@ -151,22 +159,31 @@ auto Descriptor::initialize(const DescriptorPool& pool) -> void {
   if (pool.m_pool) {
     auto device = pool.m_device->gpu;
     auto& dispatch = pool.m_device->m_dispatch;
+    auto lock = std::scoped_lock(*pool.m_lock);
     auto result = error(device.allocateDescriptorSets(info, dispatch));
     this->m_parent_map = pool.m_map;
     this->m_set = result[0];
   }
 }
 
-auto Descriptor::bind(std::string_view name, const Buffer& buffer) -> bool {
+auto Descriptor::bind_buffer(std::string_view name, std::int32_t handle, std::size_t offset, std::size_t range) -> bool {
   if (this->m_parent_map) {
+    auto& buffer = global_resources().buffers[handle];
     const auto iter = this->m_parent_map->find(std::string(name));
     auto info = vk::DescriptorBufferInfo();
     auto write = vk::WriteDescriptorSet();
 
     if (iter != this->m_parent_map->end()) {
+      // Dynamic bindings get their offsets at bind time, so only the base offset here has to line up.
+      auto& limits = this->m_device->properties.limits;
+      auto type = convert(iter->second.type);
+      auto uniform = type == vk::DescriptorType::eUniformBuffer || type == vk::DescriptorType::eUniformBufferDynamic;
+      auto alignment = uniform ? limits.minUniformBufferOffsetAlignment : limits.minStorageBufferOffsetAlignment;
+      LunaAssert(offset % std::max<vk::DeviceSize>(alignment, 1) == 0, "Buffer ranges bound to a descriptor have to start at a multiple of the device's minimum offset alignment.");
+
       info.setBuffer(buffer.buffer);
-      info.setRange(VK_WHOLE_SIZE);
-      info.setOffset(0);
+      info.setRange(range);
+      info.setOffset(offset);
 
       write.setDstSet(this->m_set);
       write.setDstBinding(iter->second.binding);
@@ -178,14 +195,22 @@ auto Descriptor::bind(std::string_view name, const Buffer& buffer) -> bool {
       auto device = this->m_device->gpu;
       auto& dispatch = this->m_device->m_dispatch;
       device.updateDescriptorSets(1, &write, 0, nullptr, dispatch);
+
+      auto binding = Binding();
+      binding.name = name;
+      binding.buffer = handle;
+      binding.offset = offset;
+      binding.range = range;
+      this->remember(std::move(binding));
       return true;
     }
   }
   return false;
 }
 
-auto Descriptor::bind(std::string_view name, const Image& image) -> bool {
+auto Descriptor::bind_image(std::string_view name, std::int32_t handle) -> bool {
   if (this->m_parent_map) {
+    auto& image = global_resources().images[handle];
     const auto iter = this->m_parent_map->find(std::string(name));
     vk::DescriptorImageInfo info;
     vk::WriteDescriptorSet write;
@@ -205,15 +230,21 @@ auto Descriptor::bind(std::string_view name, const Image& image) -> bool {
       auto device = this->m_device->gpu;
       auto& dispatch = this->m_device->m_dispatch;
       device.updateDescriptorSets(1, &write, 0, nullptr, dispatch);
+
+      auto binding = Binding();
+      binding.name = name;
+      binding.images = {handle};
+      binding.layer = image.layer;
+      this->remember(std::move(binding));
       return true;
     }
   }
   return false;
 }
 
-auto Descriptor::bind(std::string_view name, const Image** images,
-                      unsigned count) -> bool {
+auto Descriptor::bind_images(std::string_view name, const std::int32_t* handles, unsigned count) -> bool {
   if (this->m_parent_map) {
+    auto& res = global_resources();
     const auto iter = this->m_parent_map->find(std::string(name));
     unsigned amt;
     std::vector<vk::DescriptorImageInfo> infos;
@@ -224,9 +255,10 @@ auto Descriptor::bind(std::string_view name, const Image** images,
 
       infos.resize(count);
       for (unsigned index = 0; index < count; index++) {
-        infos[index].setImageLayout(images[index]->layout);
-        infos[index].setSampler(images[index]->sampler);
-        infos[index].setImageView(images[index]->view);
+        auto& image = res.images[handles[index]];
+        infos[index].setImageLayout(image.layout);
+        infos[index].setSampler(image.sampler);
+        infos[index].setImageView(image.view);
       }
 
       write.setDstSet(this->m_set);
@@ -239,15 +271,67 @@ auto Descriptor::bind(std::string_view name, const Image** images,
       auto device = this->m_device->gpu;
       auto& dispatch = this->m_device->m_dispatch;
       device.updateDescriptorSets(1, &write, 0, nullptr, dispatch);
+
+      auto binding = Binding();
+      binding.name = name;
+      binding.images.assign(handles, handles + count);
+      binding.array = true;
+      this->remember(std::move(binding));
       return true;
     }
   }
   return false;
 }
 
+auto Descriptor::remember(Binding binding) -> void {
+  // Single images bind to the array element of their layer, so those only replace a binding of the same layer.
+  auto replaces = [&binding](const Binding& old) {
+    if(old.name != binding.name) return false;
+    auto single = [](const Binding& b) {return b.buffer < 0 && !b.array;};
+    if(single(old) && single(binding)) return old.layer == binding.layer;
+    return true;
+  };
+
+  auto iter = std::remove_if(this->m_bindings.begin(), this->m_bindings.end(), replaces);
+  this->m_bindings.erase(iter, this->m_bindings.end());
+  this->m_bindings.push_back(std::move(binding));
+}
+
+auto Descriptor::rebind(const std::vector<std::int32_t>& buffers, const std::vector<std::int32_t>& images) -> void {
+  auto& res = global_resources();
+  auto moved = [&](const Binding& binding) {
+    if(binding.buffer >= 0) return std::find(buffers.begin(), buffers.end(), binding.buffer) != buffers.end();
+    return std::any_of(binding.images.begin(), binding.images.end(), [&images](std::int32_t img) {
+      return std::find(images.begin(), images.end(), img) != images.end();
+    });
+  };
+
+  // Bindings to anything destroyed since are left alone, the set can't be used without binding over them anyway.
+  auto alive = [&](const Binding& binding) {
+    if(binding.buffer >= 0) return res.buffers.valid(binding.buffer);
+    return std::all_of(binding.images.begin(), binding.images.end(), [&res](std::int32_t img) {
+      return res.images.valid(img);
+    });
+  };
+
+  // Binding records what it writes, so work off a copy.
+  auto bindings = this->m_bindings;
+  for(auto& binding : bindings) {
+    if(!moved(binding) || !alive(binding)) continue;
+    if(binding.buffer >= 0) this->bind_buffer(binding.name, binding.buffer, binding.offset, binding.range);
+    else if(binding.array) this->bind_images(binding.name, binding.images.data(), binding.images.size());
+    else this->bind_image(binding.name, binding.images[0]);
+  }
+}
+
+auto Descriptor::bound_images(std::vector<std::int32_t>& images) const -> void {
+  for(const auto& binding : this->m_bindings) images.insert(images.end(), binding.images.begin(), binding.images.end());
+}
+
 auto DescriptorPool::make() -> int32_t { 
   auto& res = luna::vulkan::global_resources();
-  auto id = luna::vulkan::find_valid_entry(res.descriptors);
+  auto lock = std::scoped_lock(res.descriptor_lock);
+  auto id = res.descriptors.acquire();
   res.descriptors[id] = Descriptor(this);
   return id;
 }
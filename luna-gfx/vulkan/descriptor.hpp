@@ -3,10 +3,13 @@
 #include "luna-gfx/common/shader.hpp"
 #include "luna-gfx/vulkan/data_types.hpp"
 #include "luna-gfx/vulkan/device.hpp"
+#include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 #include <vulkan/vulkan.hpp>
 namespace luna {
 namespace vulkan {
@@ -29,6 +32,7 @@ class DescriptorPool {
   using UniformMap = std::unordered_map<std::string, gfx::ShaderVariable>;
   friend class Descriptor;
   std::shared_ptr<UniformMap> m_map;
+  std::shared_ptr<std::mutex> m_lock; // Descriptor pools have to be externally synchronized when allocating.
   const Device* m_device;
   const Pipeline* m_pipeline;
   size_t m_device_id;
@@ -46,10 +50,17 @@ class Descriptor {
   auto operator=(Descriptor&& desc) -> Descriptor&;
   auto initialize(const DescriptorPool& pool) -> void;
   auto reset() -> void;
-  auto bind(std::string_view name, const Image& image) -> bool;
-  auto bind(std::string_view name, const Image** images, unsigned count)
-      -> bool;
-  auto bind(std::string_view name, const Buffer& buffer) -> bool;
+  // Take handles into the global tables, which is also what the set remembers having been written with.
+  auto bind_image(std::string_view name, std::int32_t image) -> bool;
+  auto bind_images(std::string_view name, const std::int32_t* images, unsigned count) -> bool;
+  auto bind_buffer(std::string_view name, std::int32_t buffer, std::size_t offset = 0, std::size_t range = VK_WHOLE_SIZE) -> bool;
+
+  // Writes again every binding that refers to one of these, after defragmentation swapped in new objects under them.
+  // Bindings to anything since destroyed are skipped.
+  auto rebind(const std::vector<std::int32_t>& buffers, const std::vector<std::int32_t>& images) -> void;
+
+  // Adds every image bound to `images`.
+  auto bound_images(std::vector<std::int32_t>& images) const -> void;
   auto initialized() const -> bool { return this->m_set; }
   auto pipeline() const -> const Pipeline& { return *this->m_pipeline; }
   auto set() -> vk::DescriptorSet& { return this->m_set; }
@@ -57,6 +68,21 @@ class Descriptor {
  private:
   using UniformMap = DescriptorPool::UniformMap;
   friend class DescriptorPool;
+
+  // What a binding was last written with.
+  struct Binding {
+    std::string name;
+    std::int32_t buffer = -1;
+    std::size_t offset = 0;
+    std::size_t range = 0;
+    std::vector<std::int32_t> images;
+    std::size_t layer = 0; // Of a single image, which is the array element it was written to.
+    bool array = false;
+  };
+
+  auto remember(Binding binding) -> void;
+
+  std::vector<Binding> m_bindings;
   vk::DescriptorSet m_set;
   const Device* m_device;
   std::shared_ptr<UniformMap> m_parent_map;
@@ -3,10 +3,13 @@
 #include "luna-gfx/error/error.hpp"
 #include "luna-gfx/vulkan/instance.hpp"
 #include "luna-gfx/vulkan/global_resources.hpp"
+#include <algorithm>
 #include <memory>
+#include <string_view>
 #include <utility>
 namespace luna {
 namespace vulkan {
+constexpr auto cBarWindowSize = vk::DeviceSize(256) * 1024 * 1024;
 
 Device::Device() {
   this->allocate_cb = nullptr;
@@ -17,6 +20,13 @@ Device::Device(gfx::Dlloader& loader, vk::AllocationCallbacks* callback,
                         vk::PhysicalDevice device, Instance& instance, vk::DispatchLoaderDynamic& dispatch) {
   this->extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
   this->extensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
+  this->extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+#if defined(VK_EXT_host_image_copy)
+  // Host image copy builds on these, which are only core from 1.3.
+  this->extensions.push_back(VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME);
+  this->extensions.push_back(VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME);
+  this->extensions.push_back(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME);
+#endif
   this->m_score = 0.0f;
   this->physical_device = device;
   this->allocate_cb = callback;
@@ -29,8 +39,8 @@ Device::Device(gfx::Dlloader& loader, vk::AllocationCallbacks* callback,
   this->find_queue_families(dispatch);
   this->make_device(dispatch);
 
-  this->find_memory_info();
   this->mem_prop = device.getMemoryProperties(dispatch);
+  this->find_memory_info();
 
   this->m_dispatch.init(instance.m_instance,
                         reinterpret_cast<PFN_vkGetInstanceProcAddr>(
@@ -38,20 +48,38 @@ Device::Device(gfx::Dlloader& loader, vk::AllocationCallbacks* callback,
                         this->gpu);
 
   this->find_queues();
+  this->make_timelines();
 }
 
 Device::Device(Device&& mv) { *this = std::move(mv); }
 
 Device::~Device() {
+  for (auto& q : this->queues) {
+    if (q.timeline) this->gpu.destroy(q.timeline, this->allocate_cb, this->m_dispatch);
+  }
   if (this->gpu) {
     this->gpu.destroy(this->allocate_cb, global_resources().instance->m_dispatch);
   }
 }
 
 auto Device::wait_idle() -> void {
+  // Waiting on the device counts as using every queue on it.
+  auto& q = this->queues;
+  auto lock = std::scoped_lock(q[GRAPHICS].lock, q[COMPUTE].lock, q[TRANSFER].lock, q[SPARSE].lock);
   error(this->gpu.waitIdle(this->m_dispatch));
 }
 
+auto Device::queue_owner(vk::Queue queue) -> Queue& {
+  for(auto& q : this->queues) {
+    if(q.queue == queue) return q;
+  }
+  return this->graphics();
+}
+
+auto Device::queue_lock(vk::Queue queue) -> std::mutex& {
+  return this->queue_owner(queue).lock;
+}
+
 auto Device::operator=(Device&& mv) -> Device& {
   this->allocate_cb = mv.allocate_cb;
   this->gpu = mv.gpu;
@@ -68,6 +96,9 @@ auto Device::operator=(Device&& mv) -> Device& {
   this->extensions = mv.extensions;
   this->validation = mv.validation;
   this->m_score = mv.m_score;
+  this->buffer_device_address = mv.buffer_device_address;
+  this->resizable_bar = mv.resizable_bar;
+  this->host_image_copy = mv.host_image_copy;
 
   mv.allocate_cb = nullptr;
   mv.gpu = nullptr;
@@ -79,6 +110,9 @@ auto Device::operator=(Device&& mv) -> Device& {
   mv.features = vk::PhysicalDeviceFeatures();
   mv.id = 0;
   mv.m_score = 0.f;
+  mv.buffer_device_address = false;
+  mv.resizable_bar = false;
+  mv.host_image_copy = false;
   mv.queue_props.clear();
   mv.extensions.clear();
   mv.validation.clear();
@@ -145,21 +179,55 @@ auto Device::make_device(vk::DispatchLoaderDynamic& dispatch) -> void {
 
   vk::PhysicalDeviceProperties2 props;
 
+  // Only ask for what the device has, anything else fails device creation.
+  auto supported = this->physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceBufferDeviceAddressFeatures, vk::PhysicalDeviceTimelineSemaphoreFeatures>(dispatch);
+  auto& core = supported.get<vk::PhysicalDeviceFeatures2>().features;
+  this->features.setShaderInt64(core.shaderInt64);
+  this->features.setFragmentStoresAndAtomics(core.fragmentStoresAndAtomics);
+  this->features.setVertexPipelineStoresAndAtomics(core.vertexPipelineStoresAndAtomics);
+
   auto& features2 = this->m_device_info.get<vk::PhysicalDeviceFeatures2>();
   features2.setFeatures(this->features);
-  this->features.setShaderInt64(true);
-  this->features.setFragmentStoresAndAtomics(true);
-  this->features.setVertexPipelineStoresAndAtomics(true);
 
+  auto& address = this->m_device_info.get<vk::PhysicalDeviceBufferDeviceAddressFeatures>();
+  address.setBufferDeviceAddress(supported.get<vk::PhysicalDeviceBufferDeviceAddressFeatures>().bufferDeviceAddress);
+  this->buffer_device_address = address.bufferDeviceAddress;
+
+  // Every submit is tracked through timeline semaphores, which Vulkan 1.2 guarantees.
+  auto& timeline = this->m_device_info.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>();
+  timeline.setTimelineSemaphore(supported.get<vk::PhysicalDeviceTimelineSemaphoreFeatures>().timelineSemaphore);
+  LunaAssert(timeline.timelineSemaphore, "Timeline semaphores not supported on this graphics card.");
+
+  // The atomic float extensions aren't requested, so their structs can't be passed along.
+  this->m_device_info.unlink<vk::PhysicalDeviceShaderAtomicFloat2FeaturesEXT>();
+  this->m_device_info.unlink<vk::PhysicalDeviceShaderAtomicFloatFeaturesEXT>();
+
+  // Features go through the chain hanging off of the create info, so pEnabledFeatures stays null.
   info.setQueueCreateInfos(queue_infos);
   info.setEnabledExtensionCount(extensions.size());
   info.setPpEnabledExtensionNames(extensions.data());
   info.setEnabledLayerCount(validation.size());
   info.setPpEnabledLayerNames(validation.data());
-  info.pNext = nullptr;
-  //      info.setPNext                  ( &this->pnext_chain ) ;
+
+#if defined(VK_EXT_host_image_copy)
+  // Only exists if the extension does, so it goes in front of the chain instead of in it.
+  auto host_copy = vk::PhysicalDeviceHostImageCopyFeaturesEXT();
+  if (this->has_extension(VK_KHR_COPY_COMMANDS_2_EXTENSION_NAME) &&
+      this->has_extension(VK_KHR_FORMAT_FEATURE_FLAGS_2_EXTENSION_NAME) &&
+      this->has_extension(VK_EXT_HOST_IMAGE_COPY_EXTENSION_NAME)) {
+    auto host_support = this->physical_device.getFeatures2<vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceHostImageCopyFeaturesEXT>(dispatch);
+    host_copy.setHostImageCopy(host_support.get<vk::PhysicalDeviceHostImageCopyFeaturesEXT>().hostImageCopy);
+    host_copy.setPNext(const_cast<void*>(info.pNext));
+    info.setPNext(&host_copy);
+    this->host_image_copy = host_copy.hostImageCopy;
+  }
+#endif
   error(this->physical_device.createDevice(&info, this->allocate_cb, &this->gpu,
                                            dispatch));
+#if defined(VK_EXT_host_image_copy)
+  // The chain outlives this function, so it can't keep pointing at a local.
+  if (info.pNext == &host_copy) info.setPNext(host_copy.pNext);
+#endif
 }
 
 auto Device::make_extensions(vk::DispatchLoaderDynamic& dispatch) -> std::vector<const char*> {
@@ -171,7 +239,9 @@ auto Device::make_extensions(vk::DispatchLoaderDynamic& dispatch) -> std::vector
 
   auto copy = this->extensions;
 
+  // The returned list points into these strings, so they can't move once added.
   this->extensions.clear();
+  this->extensions.reserve(copy.size());
   for (const auto& ext : available_extentions) {
     for (const auto& requested : copy) {
       if (std::string(&ext.extensionName[0]) == requested) {
@@ -184,6 +254,10 @@ auto Device::make_extensions(vk::DispatchLoaderDynamic& dispatch) -> std::vector
   return list;
 }
 
+auto Device::has_extension(std::string_view name) const -> bool {
+  return std::find(this->extensions.begin(), this->extensions.end(), name) != this->extensions.end();
+}
+
 auto Device::check_limits() -> void {
   if(!this->gpu) return;
 
@@ -223,23 +297,29 @@ auto Device::find_queues() -> void {
   }
 
   // Set graphics to the defacto default because this queue is guaranteed to be
-  // able to to everything + graphics.
+  // able to to everything + graphics. Stand-ins take the family id too, so that
+  // command pools for them get created on a family that exists.
   auto last_queue = this->queues[GRAPHICS].queue;
+  auto last_id = this->queues[GRAPHICS].id;
 
   if (this->queues[COMPUTE].id != UINT_MAX) {
     this->queues[COMPUTE].queue =
         this->gpu.getQueue(this->queues[COMPUTE].id, 0, this->m_dispatch);
     last_queue = this->queues[COMPUTE].queue;
+    last_id = this->queues[COMPUTE].id;
   } else {
     this->queues[COMPUTE].queue = last_queue;
+    this->queues[COMPUTE].id = last_id;
   }
 
   if (this->queues[TRANSFER].id != UINT_MAX) {
     this->queues[TRANSFER].queue =
         this->gpu.getQueue(this->queues[TRANSFER].id, 0, this->m_dispatch);
     last_queue = this->queues[TRANSFER].queue;
+    last_id = this->queues[TRANSFER].id;
   } else {
-    this->queues[COMPUTE].queue = last_queue;
+    this->queues[TRANSFER].queue = last_queue;
+    this->queues[TRANSFER].id = last_id;
   }
 
   if (this->queues[SPARSE].id != UINT_MAX) {
@@ -248,6 +328,20 @@ auto Device::find_queues() -> void {
     last_queue = this->queues[SPARSE].queue;
   } else {
     this->queues[SPARSE].queue = last_queue;
+    this->queues[SPARSE].id = last_id;
+  }
+}
+
+auto Device::make_timelines() -> void {
+  auto type_info = vk::SemaphoreTypeCreateInfo();
+  type_info.setSemaphoreType(vk::SemaphoreType::eTimeline);
+  type_info.setInitialValue(0);
+  auto info = vk::SemaphoreCreateInfo();
+  info.setPNext(&type_info);
+  for (auto& q : this->queues) {
+    if (&this->queue_owner(q.queue) != &q) continue;
+    q.timeline = error(this->gpu.createSemaphore(info, this->allocate_cb, this->m_dispatch));
+    q.value = 0;
   }
 }
 
@@ -268,6 +362,11 @@ auto Device::find_memory_info() -> void {
 
     if (host_visible) heap.type = HeapType::HostVisible | heap.type;
     if (device_capable) heap.type = HeapType::GpuOnly | heap.type;
+
+    // Without resizable BAR, the host only sees a small window of device memory. Integrated GPUs share system memory,
+    // so all of it looks device local & host visible without there being any BAR to speak of.
+    auto discrete = this->properties.deviceType == vk::PhysicalDeviceType::eDiscreteGpu;
+    if (discrete && host_visible && device_capable && vk_heap.size > cBarWindowSize) this->resizable_bar = true;
   }
 }
 
@@ -3,8 +3,10 @@
 #include "luna-gfx/common/dlloader.hpp"
 #include <array>
 #include <climits>
+#include <cstdint>
 #include <mutex>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <vulkan/vulkan.hpp>
 namespace luna {
@@ -40,10 +42,16 @@ struct Queue {
   unsigned id = UINT_MAX;
   std::mutex lock;
 
+  // Every submit signals the next value on this. Only set on the first Queue of each vk::Queue, see queue_owner().
+  vk::Semaphore timeline;
+  std::uint64_t value = 0; // Last value submitted to be signaled. Guarded by lock.
+
   auto operator=(const Queue& cpy) -> Queue& {
     this->queue = cpy.queue;
     this->priority = cpy.priority;
     this->id = cpy.id;
+    this->timeline = cpy.timeline;
+    this->value = cpy.value;
     return *this;
   }
 };
@@ -68,11 +76,19 @@ struct Device {
   auto score() -> float;
   auto check_support(vk::SurfaceKHR surface) const -> void;
   auto wait_idle() -> void;
+
+  // Whether a device extension was requested & is supported.
+  [[nodiscard]] auto has_extension(std::string_view name) const -> bool;
+
+  // Queues fall back onto one another when a family is missing, so lock & signal through the Queue that owns the
+  // vk::Queue instead of whichever one it was looked up by.
+  [[nodiscard]] auto queue_owner(vk::Queue queue) -> Queue&;
+  [[nodiscard]] auto queue_lock(vk::Queue queue) -> std::mutex&;
   [[nodiscard]] inline auto graphics() -> Queue& { return this->queues[GRAPHICS]; }
   [[nodiscard]] inline auto compute() -> Queue& { return this->queues[COMPUTE]; }
   [[nodiscard]] inline auto transfer() -> Queue& { return this->queues[TRANSFER]; }
   [[nodiscard]] inline auto sparse() -> Queue& { return this->queues[SPARSE]; }
-  using FeaturesChain = vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceShaderAtomicFloat2FeaturesEXT, vk::PhysicalDeviceShaderAtomicFloatFeaturesEXT>;
+  using FeaturesChain = vk::StructureChain<vk::DeviceCreateInfo, vk::PhysicalDeviceFeatures2, vk::PhysicalDeviceShaderAtomicFloat2FeaturesEXT, vk::PhysicalDeviceShaderAtomicFloatFeaturesEXT, vk::PhysicalDeviceBufferDeviceAddressFeatures, vk::PhysicalDeviceTimelineSemaphoreFeatures>;
   vk::AllocationCallbacks* allocate_cb;
   vk::Device gpu;
   vk::PhysicalDevice physical_device;
@@ -89,11 +105,15 @@ struct Device {
   std::vector<std::string> extensions;
   std::vector<std::string> validation;
   float m_score;
+  bool buffer_device_address = false; // Whether buffers can hand out their GPU addresses.
+  bool resizable_bar = false;         // Whether the host can map all of device local memory, not just a 256MB window.
+  bool host_image_copy = false;       // Whether images can be written straight from host memory (VK_EXT_host_image_copy).
 
   private:
     inline auto check_limits() -> void;
     inline auto find_memory_info() -> void;
     inline auto find_queues() -> void;
+    inline auto make_timelines() -> void;
     inline auto find_queue_families(vk::DispatchLoaderDynamic& dispatch) -> void;
     inline auto make_device(vk::DispatchLoaderDynamic& dispatch) -> void;
     inline auto make_extensions(vk::DispatchLoaderDynamic& dispatch) -> std::vector<const char*>;
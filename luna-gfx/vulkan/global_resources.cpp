@@ -11,16 +11,13 @@
 #include "luna-gfx/vulkan/window.hpp"
 #include "luna-gfx/vulkan/utils/helper_functions.hpp"
 //#include "luna-gfx/vulkan/pipeline.hpp"
+#include <algorithm>
 #include <memory>
 #include <utility>
 #include <vector>
 namespace luna {
 namespace vulkan {
-constexpr auto MAX_OBJECT_AMT = 1024;
-constexpr auto MAX_CMD_AMT = 64;
-constexpr auto MAX_WINDOW_AMT = 10;
-
-static auto get_pool_map() -> std::map<vk::Device, std::map<int, vk::CommandPool>>& {
+static auto get_pool_map() -> std::map<vk::Device, std::vector<std::shared_ptr<ThreadPool>>>& {
   return global_resources().pool_map;
 }
 
@@ -29,29 +26,66 @@ inline auto reset_command_pools(std::vector<Device>& devices) -> void {
   for(auto& device_map : pool_map) {
     for(auto& pool : device_map.second) {
       for(auto& tmp : devices) {
-        if(tmp.gpu == device_map.first && pool.second) {
-          device_map.first.destroyCommandPool(pool.second, tmp.allocate_cb, tmp.m_dispatch);
+        if(tmp.gpu == device_map.first && pool->pool) {
+          device_map.first.destroyCommandPool(pool->pool, tmp.allocate_cb, tmp.m_dispatch);
         }
       }
     }
   }
+  pool_map.clear();
 }
 
-auto create_pool(Device& device, int queue_family) -> vk::CommandPool {
-  const auto flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;  // TODO make this configurable.
-  
-  auto& pool_map = get_pool_map();
-  auto& queue_map = pool_map[device.gpu];
-  auto iter = queue_map.find(queue_family);
-  if (iter == queue_map.end()) {
-    auto info = vk::CommandPoolCreateInfo();
-    info.setFlags(flags);
-    info.setQueueFamilyIndex(queue_family);
-    auto pool = error(device.gpu.createCommandPool(
-        info, device.allocate_cb, device.m_dispatch));
-    iter = queue_map.insert(iter, {queue_family, pool});
-  };
-  return iter->second;
+/** The pools made for the thread it belongs to. Looked up without locking, since only that thread ever touches it.
+ * When the thread exits, frees whatever garbage its pools collected & orphans them.
+ */
+struct ThreadPools {
+  std::map<std::pair<vk::Device, int>, std::shared_ptr<ThreadPool>> pools;
+
+  ~ThreadPools() {
+    if(this->pools.empty()) return;
+    auto& devices = global_resources().devices;
+    for(auto& entry : this->pools) {
+      auto& pool = *entry.second;
+      auto device = std::find_if(devices.begin(), devices.end(), [&](Device& dev) {return dev.gpu == entry.first.first;});
+      if(device == devices.end()) continue;
+      auto lock = std::scoped_lock(pool.lock);
+      if(!pool.garbage.empty()) device->gpu.freeCommandBuffers(pool.pool, pool.garbage, device->m_dispatch);
+      pool.garbage.clear();
+      pool.orphaned = true;
+      if(pool.live == 0) destroy_orphaned_pool(*device, pool);
+    }
+  }
+};
+
+static thread_local ThreadPools thread_pools;
+
+auto create_pool(Device& device, int queue_family) -> std::shared_ptr<ThreadPool> {
+  // Lists from these get reset one at a time as they're begun again. gfx::FrameCommands uses transient pools instead.
+  const auto flags = vk::CommandPoolCreateFlagBits::eResetCommandBuffer;
+
+  auto& pool = thread_pools.pools[{device.gpu, queue_family}];
+  if(pool) return pool;
+
+  auto info = vk::CommandPoolCreateInfo();
+  info.setFlags(flags);
+  info.setQueueFamilyIndex(queue_family);
+  pool = std::make_shared<ThreadPool>();
+  pool->pool = error(device.gpu.createCommandPool(info, device.allocate_cb, device.m_dispatch));
+  pool->owner = std::this_thread::get_id();
+
+  auto lock = std::scoped_lock(global_resources().pool_lock);
+  get_pool_map()[device.gpu].push_back(pool);
+  return pool;
+}
+
+auto destroy_orphaned_pool(Device& device, ThreadPool& pool) -> void {
+  // Destroying the pool frees every list still in it, garbage included.
+  device.gpu.destroy(pool.pool, device.allocate_cb, device.m_dispatch);
+  pool.pool = nullptr;
+
+  auto lock = std::scoped_lock(global_resources().pool_lock);
+  auto& pools = get_pool_map()[device.gpu];
+  pools.erase(std::remove_if(pools.begin(), pools.end(), [&](auto& tmp) {return tmp.get() == &pool;}), pools.end());
 }
 
 inline auto GlobalResources::make_instance() -> void {
@@ -101,34 +135,39 @@ inline auto GlobalResources::find_gpus() -> void {
     alloc_create_info.pVulkanFunctions = &vulkan_funcs;
     alloc_create_info.instance = this->instance->m_instance;
 
+    // Lets VMA report real per-process budgets instead of guessing from heap sizes.
+    if(this->devices[index].has_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+      alloc_create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+
+    // Memory for buffers with device addresses has to be allocated to allow them.
+    if(this->devices[index].buffer_device_address)
+      alloc_create_info.flags |= VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
+
     if(alloc_create_info.device && alloc_create_info.physicalDevice)
-      vmaCreateAllocator(&alloc_create_info, &this->allocators[index++]);
+      vmaCreateAllocator(&alloc_create_info, &this->allocators[index]);
   }
 }
 
 GlobalResources::GlobalResources() {
   this->make_instance();
   this->find_gpus();
+
+  // Every table starts out empty and grows a chunk at a time as objects are created.
   this->semaphores.resize(this->devices.size());
-  this->buffers.resize(MAX_OBJECT_AMT);
-  this->images.resize(MAX_OBJECT_AMT);
-  this->pipelines.resize(MAX_OBJECT_AMT);
-  this->descriptors.resize(MAX_OBJECT_AMT);
-  this->render_passes.resize(MAX_OBJECT_AMT);
-  this->cmds.resize(MAX_CMD_AMT);
-  this->swapchains.resize(MAX_WINDOW_AMT);
-  this->windows.resize(MAX_WINDOW_AMT);
+  this->deletion_queues.resize(this->devices.size());
+  this->staging_pools.resize(this->devices.size());
+  this->memory_budgets.resize(this->devices.size());
+  this->memory_pools.resize(this->devices.size());
+  this->defragmenters.resize(this->devices.size());
+  this->completion_services.resize(this->devices.size());
+}
 
-  for(auto index = 0u; index < this->semaphores.size(); index++) {
-    auto& gpu = this->devices[index];
-    auto info = vk::SemaphoreCreateInfo();
-    if(gpu.gpu) {
-      this->semaphores[index].resize(MAX_OBJECT_AMT);
-      for(auto& sem : this->semaphores[index]) {
-        sem.sem = error(gpu.gpu.createSemaphore(info, gpu.allocate_cb, gpu.m_dispatch)) ;
-      }
-    }
-  }
+auto GlobalResources::memory_usage() const -> std::size_t {
+  auto bytes = this->buffers.memory_usage() + this->images.memory_usage() + this->cmds.memory_usage() +
+               this->pipelines.memory_usage() + this->descriptors.memory_usage() +
+               this->render_passes.memory_usage() + this->swapchains.memory_usage() + this->windows.memory_usage();
+  for(const auto& sems : this->semaphores) bytes += sems.memory_usage();
+  return bytes;
 }
 
 GlobalResources::~GlobalResources() {
@@ -141,59 +180,65 @@ GlobalResources::~GlobalResources() {
    * If a test fails because of this, FIX IT!!!!!
    */
 
-  // These move-only objects need to be moved out of to properly be destroyed (have their deconstructors called).
-  for(auto& dev : this->cmds) {
-    auto tmp = std::move(dev);
+  // Anything still waiting on the GPU has to go first, while everything it references is still alive.
+  for(auto index = 0u; index < this->deletion_queues.size(); index++) {
+    if(this->devices[index].gpu) this->devices[index].wait_idle();
+    this->completion_services[index].stop(index);
+    this->deletion_queues[index].flush();
+    this->staging_pools[index].clear();
   }
 
-  for(auto& rp : this->render_passes) {
+  // These move-only objects need to be moved out of to properly be destroyed (have their deconstructors called).
+  this->cmds.for_each([](int32_t, CommandBuffer& cmd) {
+    auto tmp = std::move(cmd);
+  });
+
+  this->render_passes.for_each([](int32_t, RenderPass& rp) {
     auto tmp = std::move(rp);
-  }
+  });
 
-  for(auto& dev : this->swapchains) {
-    auto tmp = std::move(dev);
-  }
+  this->swapchains.for_each([](int32_t, Swapchain& swap) {
+    auto tmp = std::move(swap);
+  });
 
-  for(auto& dev : this->descriptors) {
-    auto tmp = std::move(dev);
-  }
+  this->descriptors.for_each([](int32_t, Descriptor& desc) {
+    auto tmp = std::move(desc);
+  });
 
-  for(auto& dev : this->pipelines) {
-    auto tmp = std::move(dev);
-  }
-
-  for(auto& dev : this->windows) {
-    auto tmp = std::move(dev);
-  }
+  this->pipelines.for_each([](int32_t, Pipeline& pipe) {
+    auto tmp = std::move(pipe);
+  });
 
+  this->windows.for_each([](int32_t, Window& window) {
+    auto tmp = std::move(window);
+  });
 
   // For data types, explicitly destroy them.
-  auto index = 0;
-  for(auto& a : this->buffers) {
-    if(a.valid()) luna::vulkan::destroy_buffer(index++);
-  }
+  this->buffers.for_each([](int32_t handle, Buffer&) {
+    luna::vulkan::destroy_buffer(handle);
+  });
 
-  index = 0;
-  for(auto& a : this->images) {
-    if(a.valid()) luna::vulkan::destroy_image(index++);
+  this->images.for_each([](int32_t handle, Image&) {
+    luna::vulkan::destroy_image(handle);
+  });
+
+  for(auto index = 0u; index < this->defragmenters.size(); index++) {
+    this->defragmenters[index].cancel(index);
+    this->memory_pools[index].clear(index);
   }
 
   for(auto& alloc : this->allocators) {
     if(alloc) vmaDestroyAllocator(alloc);
   }
 
-  this->buffers.clear();
-  this->images.clear();
-  
   for(auto index = 0u; index < this->semaphores.size(); index++) {
-    auto& sem_vec = this->semaphores[index];
     auto& gpu = this->devices[index];
 
-    for(auto& sem : sem_vec) {
-      gpu.gpu.destroy(sem.sem, gpu.allocate_cb, gpu.m_dispatch);
+    // Semaphores are kept alive in their slots after release so they can be reused, so destroy every slot's.
+    for(auto slot = 0u; slot < this->semaphores[index].capacity(); slot++) {
+      auto& sem = this->semaphores[index].at_index(slot);
+      if(sem.sem) gpu.gpu.destroy(sem.sem, gpu.allocate_cb, gpu.m_dispatch);
     }
-
-    sem_vec.clear();
   }
 
   this->semaphores.clear();
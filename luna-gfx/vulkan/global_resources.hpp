@@ -1,15 +1,25 @@
 #pragma once
 #include "luna-gfx/common/dlloader.hpp"
+#include "luna-gfx/common/slot_map.hpp"
+#include "luna-gfx/vulkan/deletion_queue.hpp"
+#include "luna-gfx/vulkan/staging_pool.hpp"
+#include "luna-gfx/vulkan/memory_budget.hpp"
+#include "luna-gfx/vulkan/memory_pools.hpp"
+#include "luna-gfx/vulkan/defragmenter.hpp"
+#include "luna-gfx/vulkan/completion_service.hpp"
 #include "luna-gfx/interface/image.hpp"
 #include "luna-gfx/error/error.hpp"
 #include <vk_mem_alloc.h>
 #include <vulkan/vulkan.hpp>
+#include <memory>
 #include <vector>
 #include <utility>
 #include <atomic>
 #include <unordered_map>
 #include <array>
 #include <map>
+#include <mutex>
+#include <thread>
 namespace luna {
 namespace vulkan {
 class Descriptor;
@@ -24,24 +34,62 @@ struct CommandBuffer;
 struct Image;
 struct Buffer;
 struct Semaphore;
-auto create_pool(Device& device, int queue_family) -> vk::CommandPool;
+/** One thread's command pool for a queue family.
+ * While the thread is alive only it touches the pool, so lists destroyed on other threads are left as garbage for it to
+ * free. Once the thread exits the pool is orphaned: anyone can free into it, and it's destroyed with its last list.
+ */
+struct ThreadPool {
+  vk::CommandPool pool = {};
+  std::thread::id owner = {};
+  std::mutex lock; // Guards everything below. Only contended by other threads destroying this pool's lists.
+  std::vector<vk::CommandBuffer> garbage = {};
+  std::size_t live = 0; // Lists allocated from the pool & not yet destroyed.
+  bool orphaned = false;
+};
+
+// The calling thread's pool for the queue family, made the first time it's asked for. Only locks the first time.
+auto create_pool(Device& device, int queue_family) -> std::shared_ptr<ThreadPool>;
+
+// Destroys an orphaned pool that has no lists left. Must be called with the pool's lock held.
+auto destroy_orphaned_pool(Device& device, ThreadPool& pool) -> void;
 
 struct GlobalResources {
-  std::map<vk::Device, std::map<int, vk::CommandPool>> pool_map;
+  // Every thread's pools, so the ones still around at shutdown can be destroyed. Only touched when a thread makes its
+  // first pool for a family, or an orphaned one is destroyed. Not keyed by thread, since exited threads' ids get reused.
+  std::map<vk::Device, std::vector<std::shared_ptr<ThreadPool>>> pool_map;
+  std::mutex pool_lock;
+
+  // Guards creating & destroying windows, since they acquire from two tables at once.
+  std::mutex window_lock;
+
+  // Guards the descriptor table & writing its sets, so the defragmenter can rewrite them while the app binds.
+  std::mutex descriptor_lock;
   
   gfx::Dlloader vulkan_loader;
   std::unique_ptr<Instance> instance;
   std::vector<VmaAllocator> allocators;
   std::vector<Device> devices;
-  std::vector<Buffer> buffers;
-  std::vector<Image> images;
-  std::vector<std::vector<Semaphore>> semaphores;
-  std::vector<CommandBuffer> cmds;
-  std::vector<Pipeline> pipelines;
-  std::vector<Descriptor> descriptors;
-  std::vector<RenderPass> render_passes;
-  std::vector<Swapchain> swapchains;
-  std::vector<Window> windows;
+  gfx::SlotMap<Buffer> buffers;
+  gfx::SlotMap<Image> images;
+  std::vector<gfx::SlotMap<Semaphore>> semaphores;
+  std::vector<DeletionQueue> deletion_queues;
+  std::vector<StagingPool> staging_pools;
+  std::vector<MemoryBudget> memory_budgets;
+  std::vector<MemoryPools> memory_pools;
+  std::vector<Defragmenter> defragmenters;
+  std::vector<CompletionService> completion_services;
+  gfx::SlotMap<CommandBuffer> cmds;
+  gfx::SlotMap<Pipeline> pipelines;
+  gfx::SlotMap<Descriptor> descriptors;
+  gfx::SlotMap<RenderPass> render_passes;
+
+  // Windows and swapchains are always acquired & released together, so they share handles.
+  // There are only ever a handful of these, so they grow in much smaller chunks.
+  gfx::SlotMap<Swapchain, 4, 256> swapchains;
+  gfx::SlotMap<Window, 4, 256> windows;
+
+  // Bytes of host memory currently held by the object tables.
+  auto memory_usage() const -> std::size_t;
   private:
     GlobalResources();
     ~GlobalResources();
@@ -51,16 +99,5 @@ struct GlobalResources {
 };
 
 auto global_resources() -> GlobalResources&;
-
-template<typename T>
-auto find_valid_entry(const T& container) -> size_t {
-  auto index = 0u;
-  for(const auto& a : container) {
-    if(!a.valid()) {return index;}
-    index++;
-  }
-  LunaAssert(false, "Ran out of space!");
-  return 0;
-}
 }
 }
\ No newline at end of file
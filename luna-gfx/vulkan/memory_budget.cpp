@@ -0,0 +1,134 @@
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include "luna-gfx/vulkan/memory_budget.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/vulkan/device.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <vk_mem_alloc.h>
+#include <utility>
+namespace luna {
+namespace vulkan {
+inline auto index_of(gfx::MemoryType type) -> std::size_t {
+  return static_cast<std::size_t>(type);
+}
+
+MemoryBudget::MemoryBudget(MemoryBudget&& mv) {
+  *this = std::move(mv);
+}
+
+auto MemoryBudget::operator=(MemoryBudget&& mv) -> MemoryBudget& {
+  this->m_usage = mv.m_usage;
+  this->m_image_usage = mv.m_image_usage;
+  this->m_listeners = std::move(mv.m_listeners);
+  this->m_next_id = mv.m_next_id;
+  this->m_frame = mv.m_frame;
+  return *this;
+}
+
+auto MemoryBudget::allocated(gfx::MemoryType type, std::size_t bytes) -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  this->m_usage[index_of(type)] += bytes;
+}
+
+auto MemoryBudget::freed(gfx::MemoryType type, std::size_t bytes) -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  auto& usage = this->m_usage[index_of(type)];
+  LunaAssert(usage >= bytes, "Freeing more buffer memory than was ever allocated.");
+  usage -= bytes;
+}
+
+auto MemoryBudget::allocated_image(std::size_t bytes) -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  this->m_image_usage += bytes;
+}
+
+auto MemoryBudget::freed_image(std::size_t bytes) -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  LunaAssert(this->m_image_usage >= bytes, "Freeing more image memory than was ever allocated.");
+  this->m_image_usage -= bytes;
+}
+
+auto MemoryBudget::usage(gfx::MemoryType type) const -> std::size_t {
+  auto lock = std::scoped_lock(this->m_lock);
+  return this->m_usage[index_of(type)];
+}
+
+auto MemoryBudget::image_usage() const -> std::size_t {
+  auto lock = std::scoped_lock(this->m_lock);
+  return this->m_image_usage;
+}
+
+auto MemoryBudget::heaps(int gpu) const -> std::vector<gfx::MemoryHeapInfo> {
+  auto& res = global_resources();
+  auto& device = res.devices[gpu];
+  auto allocator = res.allocators[gpu];
+  if(!allocator) return {};
+
+  auto budgets = std::array<VmaBudget, VK_MAX_MEMORY_HEAPS>();
+  vmaGetHeapBudgets(allocator, budgets.data());
+
+  auto heaps = std::vector<gfx::MemoryHeapInfo>(device.mem_prop.memoryHeapCount);
+  for(auto index = 0u; index < heaps.size(); index++) {
+    auto& vk_heap = device.mem_prop.memoryHeaps[index];
+    heaps[index].size = vk_heap.size;
+    heaps[index].budget = budgets[index].budget;
+    heaps[index].usage = budgets[index].usage;
+    heaps[index].device_local = static_cast<bool>(vk_heap.flags & vk::MemoryHeapFlagBits::eDeviceLocal);
+  }
+  return heaps;
+}
+
+auto MemoryBudget::add_callback(float threshold, gfx::MemoryPressureCallback callback) -> std::int32_t {
+  auto lock = std::scoped_lock(this->m_lock);
+  auto id = this->m_next_id++;
+  this->m_listeners[id] = {threshold, std::move(callback)};
+  return id;
+}
+
+auto MemoryBudget::remove_callback(std::int32_t id) -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  this->m_listeners.erase(id);
+}
+
+auto MemoryBudget::next_frame(int gpu) -> void {
+  auto& res = global_resources();
+  if(!res.allocators[gpu]) return;
+  {
+    auto lock = std::scoped_lock(this->m_lock);
+    vmaSetCurrentFrameIndex(res.allocators[gpu], ++this->m_frame);
+  }
+  this->notify(gpu, false);
+}
+
+auto MemoryBudget::out_of_memory(int gpu) -> void {
+  this->notify(gpu, true);
+}
+
+auto MemoryBudget::notify(int gpu, bool out_of_memory) -> void {
+  // Listeners get to remove themselves or destroy things, so call them on a copy & without the lock.
+  auto listeners = std::map<std::int32_t, Listener>();
+  {
+    auto lock = std::scoped_lock(this->m_lock);
+    if(this->m_listeners.empty()) return;
+    listeners = this->m_listeners;
+  }
+
+  auto heaps = this->heaps(gpu);
+  for(auto index = 0u; index < heaps.size(); index++) {
+    auto& heap = heaps[index];
+    if(heap.budget == 0) continue;
+
+    auto pressure = gfx::MemoryPressure();
+    pressure.gpu = gpu;
+    pressure.heap = index;
+    pressure.usage = heap.usage;
+    pressure.budget = heap.budget;
+    pressure.out_of_memory = out_of_memory;
+
+    auto ratio = static_cast<double>(heap.usage) / static_cast<double>(heap.budget);
+    for(auto& listener : listeners) {
+      if(out_of_memory || ratio >= listener.second.threshold) listener.second.callback(pressure);
+    }
+  }
+}
+}
+}
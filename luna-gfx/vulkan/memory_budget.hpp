@@ -0,0 +1,59 @@
+#pragma once
+#include "luna-gfx/interface/buffer.hpp"
+#include "luna-gfx/interface/device.hpp"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <vector>
+namespace luna {
+namespace vulkan {
+/** Tracks how much device memory is in use, and tells listeners when a heap gets close to running out.
+ * Buffers are counted per gfx::MemoryType as they're created & destroyed, images in a count of their own.
+ * Heap budgets come from VMA, which reads them through VK_EXT_memory_budget when the device has it & estimates otherwise.
+ */
+class MemoryBudget {
+  public:
+    MemoryBudget() = default;
+    MemoryBudget(MemoryBudget&& mv);
+    MemoryBudget(const MemoryBudget& cpy) = delete;
+    ~MemoryBudget() = default;
+    auto operator=(MemoryBudget&& mv) -> MemoryBudget&;
+    auto operator=(const MemoryBudget& cpy) -> MemoryBudget& = delete;
+
+    auto allocated(gfx::MemoryType type, std::size_t bytes) -> void;
+    auto freed(gfx::MemoryType type, std::size_t bytes) -> void;
+    auto allocated_image(std::size_t bytes) -> void;
+    auto freed_image(std::size_t bytes) -> void;
+
+    [[nodiscard]] auto usage(gfx::MemoryType type) const -> std::size_t;
+    [[nodiscard]] auto image_usage() const -> std::size_t;
+    [[nodiscard]] auto heaps(int gpu) const -> std::vector<gfx::MemoryHeapInfo>;
+
+    auto add_callback(float threshold, gfx::MemoryPressureCallback callback) -> std::int32_t;
+    auto remove_callback(std::int32_t id) -> void;
+
+    // Advances VMA's frame so budgets get re-read, then checks every heap against the registered thresholds.
+    auto next_frame(int gpu) -> void;
+
+    // Tells every listener an allocation failed, so they can free memory before it's tried again.
+    auto out_of_memory(int gpu) -> void;
+
+  private:
+    struct Listener {
+      float threshold = 1.0f;
+      gfx::MemoryPressureCallback callback;
+    };
+
+    auto notify(int gpu, bool out_of_memory) -> void;
+
+    mutable std::mutex m_lock;
+    std::array<std::size_t, static_cast<std::size_t>(gfx::MemoryType::Unknown) + 1> m_usage = {};
+    std::size_t m_image_usage = 0;
+    std::map<std::int32_t, Listener> m_listeners;
+    std::int32_t m_next_id = 0;
+    std::uint32_t m_frame = 0;
+};
+}
+}
@@ -0,0 +1,133 @@
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include "luna-gfx/vulkan/memory_pools.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include <utility>
+namespace luna {
+namespace vulkan {
+MemoryPools::MemoryPools(MemoryPools&& mv) {
+  *this = std::move(mv);
+}
+
+auto MemoryPools::operator=(MemoryPools&& mv) -> MemoryPools& {
+  this->m_entries = mv.m_entries;
+  this->m_retired = std::move(mv.m_retired);
+  mv.m_entries = {};
+  return *this;
+}
+
+auto MemoryPools::pool_for(int gpu, gfx::MemoryType type, const vk::BufferCreateInfo& info, const VmaAllocationCreateInfo& alloc_info) -> VmaPool {
+  if(type == gfx::MemoryType::Unknown) return nullptr;
+  auto lock = std::scoped_lock(this->m_lock);
+  auto& entry = this->m_entries[static_cast<std::size_t>(type)];
+  auto small = entry.info.small_threshold > 0 && info.size < entry.info.small_threshold;
+
+  // The pools' memory may not be mapped, or visible to the host at all, if they were made for different access.
+  if(entry.pool || entry.small) {
+    if(entry.usage != alloc_info.usage || entry.flags != alloc_info.flags) return nullptr;
+  } else {
+    entry.usage = alloc_info.usage;
+    entry.flags = alloc_info.flags;
+  }
+
+  // Anything taking up most of a block is better off in memory of its own.
+  if(!small && entry.info.block_size > 0 && info.size > entry.info.block_size / 2) return nullptr;
+
+  auto& pool = small ? entry.small : entry.pool;
+  if(!pool) {
+    auto block_size = small ? entry.info.small_block_size : entry.info.block_size;
+    pool = this->make_pool(gpu, info, alloc_info, block_size, entry.info.max_blocks, small);
+  }
+  return pool;
+}
+
+auto MemoryPools::configure(int gpu, gfx::MemoryType type, const gfx::MemoryPoolInfo& info) -> void {
+  {
+    auto lock = std::scoped_lock(this->m_lock);
+    auto& entry = this->m_entries[static_cast<std::size_t>(type)];
+    if(entry.pool) this->m_retired.push_back(entry.pool);
+    if(entry.small) this->m_retired.push_back(entry.small);
+    entry.info = info;
+    entry.pool = nullptr;
+    entry.small = nullptr;
+  }
+
+  // Buffers already on their way out are freed by the deletion queue, so check again once they are. Whatever's
+  // destroyed later checks for itself.
+  global_resources().deletion_queues[gpu].defer([gpu]() {
+    global_resources().memory_pools[gpu].collect(gpu);
+  });
+}
+
+auto MemoryPools::collect(int gpu) -> void {
+  auto allocator = global_resources().allocators[gpu];
+  auto lock = std::scoped_lock(this->m_lock);
+  auto remaining = std::vector<VmaPool>();
+  for(auto pool : this->m_retired) {
+    auto stats = VmaStatistics{};
+    vmaGetPoolStatistics(allocator, pool, &stats);
+    if(stats.allocationCount == 0) vmaDestroyPool(allocator, pool);
+    else remaining.push_back(pool);
+  }
+  this->m_retired = std::move(remaining);
+}
+
+auto MemoryPools::usage(int gpu, gfx::MemoryType type) const -> gfx::MemoryPoolUsage {
+  auto allocator = global_resources().allocators[gpu];
+  auto lock = std::scoped_lock(this->m_lock);
+  auto& entry = this->m_entries[static_cast<std::size_t>(type)];
+  auto count = [allocator](VmaPool pool) -> std::size_t {
+    if(!pool) return 0;
+    auto stats = VmaStatistics{};
+    vmaGetPoolStatistics(allocator, pool, &stats);
+    return stats.allocationCount;
+  };
+
+  auto usage = gfx::MemoryPoolUsage();
+  usage.allocations = count(entry.pool);
+  usage.small_allocations = count(entry.small);
+  usage.retired_pools = this->m_retired.size();
+  return usage;
+}
+
+auto MemoryPools::defragmentable() const -> std::vector<VmaPool> {
+  // VMA can't defragment linear pools, so the small ones never are.
+  auto lock = std::scoped_lock(this->m_lock);
+  auto pools = std::vector<VmaPool>();
+  for(const auto& entry : this->m_entries) {
+    if(entry.pool) pools.push_back(entry.pool);
+  }
+  return pools;
+}
+
+auto MemoryPools::clear(int gpu) -> void {
+  auto allocator = global_resources().allocators[gpu];
+  auto lock = std::scoped_lock(this->m_lock);
+  for(auto& entry : this->m_entries) {
+    if(entry.pool) this->m_retired.push_back(entry.pool);
+    if(entry.small) this->m_retired.push_back(entry.small);
+    entry.pool = nullptr;
+    entry.small = nullptr;
+  }
+
+  for(auto pool : this->m_retired) vmaDestroyPool(allocator, pool);
+  this->m_retired.clear();
+}
+
+auto MemoryPools::make_pool(int gpu, const vk::BufferCreateInfo& info, const VmaAllocationCreateInfo& alloc_info, std::size_t block_size, std::size_t max_blocks, bool linear) -> VmaPool {
+  auto allocator = global_resources().allocators[gpu];
+  auto& c_info = static_cast<const VkBufferCreateInfo&>(info);
+  auto type_index = 0u;
+  if(vmaFindMemoryTypeIndexForBufferInfo(allocator, &c_info, &alloc_info, &type_index) != VK_SUCCESS) return nullptr;
+
+  auto pool_info = VmaPoolCreateInfo{};
+  pool_info.memoryTypeIndex = type_index;
+  pool_info.blockSize = block_size;
+  pool_info.maxBlockCount = max_blocks;
+  if(linear) pool_info.flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+
+  auto pool = VmaPool();
+  if(vmaCreatePool(allocator, &pool_info, &pool) != VK_SUCCESS) return nullptr;
+  return pool;
+}
+}
+}
@@ -0,0 +1,62 @@
+#pragma once
+#include "luna-gfx/interface/buffer.hpp"
+#include "luna-gfx/interface/device.hpp"
+#include <vk_mem_alloc.h>
+#include <vulkan/vulkan.hpp>
+#include <array>
+#include <cstddef>
+#include <mutex>
+#include <vector>
+namespace luna {
+namespace vulkan {
+/** Custom VMA pools for a device, one per gfx::MemoryType plus a linear one per type for small buffers.
+ * Pools are made the first time a buffer needs them, since that's when the memory type they live in is known. They only
+ * take buffers asking for the same host access as that first one. MemoryType::Unknown covers luna's own buffers, which
+ * want all sorts of memory, so those are never pooled.
+ */
+class MemoryPools {
+  public:
+    MemoryPools() = default;
+    MemoryPools(MemoryPools&& mv);
+    MemoryPools(const MemoryPools& cpy) = delete;
+    ~MemoryPools() = default;
+    auto operator=(MemoryPools&& mv) -> MemoryPools&;
+    auto operator=(const MemoryPools& cpy) -> MemoryPools& = delete;
+
+    // The pool a buffer should come out of, or null for the allocator's default ones.
+    [[nodiscard]] auto pool_for(int gpu, gfx::MemoryType type, const vk::BufferCreateInfo& info, const VmaAllocationCreateInfo& alloc_info) -> VmaPool;
+
+    // Pools already made for the type are retired. What's in them stays put, but nothing new goes in, and they're
+    // destroyed once emptied.
+    auto configure(int gpu, gfx::MemoryType type, const gfx::MemoryPoolInfo& info) -> void;
+
+    // Destroys every retired pool that has nothing left in it. Called whenever a buffer is destroyed.
+    auto collect(int gpu) -> void;
+
+    [[nodiscard]] auto usage(int gpu, gfx::MemoryType type) const -> gfx::MemoryPoolUsage;
+
+    // Every live pool that VMA can defragment.
+    [[nodiscard]] auto defragmentable() const -> std::vector<VmaPool>;
+
+    // Destroys every pool. Only once every buffer allocated from them is gone.
+    auto clear(int gpu) -> void;
+
+  private:
+    struct Entry {
+      gfx::MemoryPoolInfo info;
+      VmaPool pool = nullptr;
+      VmaPool small = nullptr;
+
+      // What the type's pools were made for. Their memory type was picked from these.
+      VmaMemoryUsage usage = VMA_MEMORY_USAGE_UNKNOWN;
+      VmaAllocationCreateFlags flags = 0;
+    };
+
+    auto make_pool(int gpu, const vk::BufferCreateInfo& info, const VmaAllocationCreateInfo& alloc_info, std::size_t block_size, std::size_t max_blocks, bool linear) -> VmaPool;
+
+    mutable std::mutex m_lock;
+    std::array<Entry, static_cast<std::size_t>(gfx::MemoryType::Unknown) + 1> m_entries;
+    std::vector<VmaPool> m_retired;
+};
+}
+}
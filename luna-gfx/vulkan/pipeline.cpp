@@ -156,10 +156,8 @@ auto Pipeline::operator=(Pipeline&& mv) -> Pipeline& {
 
 auto Pipeline::init_params() -> void {
   this->m_render_pass = nullptr;
-  this->m_push_constant_size = 128;
-  this->m_push_constant_flags = vk::ShaderStageFlagBits::eVertex |
-                                vk::ShaderStageFlagBits::eFragment |
-                                vk::ShaderStageFlagBits::eCompute;
+  this->m_push_constant_size = 0;
+  this->m_push_constant_flags = {};
 
   this->m_sample_mask = 0xFFFFFFFF;
   this->m_rasterization_info.setDepthClampEnable(false);
@@ -192,20 +190,19 @@ auto Pipeline::init_params() -> void {
 
 auto Pipeline::createLayout() -> void {
   auto info = vk::PipelineLayoutCreateInfo();
-  auto range = vk::PushConstantRange();
   auto desc_layout = vk::DescriptorSetLayout();
 
+  // Sized to what the shaders actually read, as reflected from them.
+  auto range = this->m_shader->pushConstants();
+  this->m_push_constant_size = range.size;
+  this->m_push_constant_flags = range.stageFlags;
   desc_layout = this->m_shader->layout();
 
   this->m_color_blend_info.setAttachments(this->m_color_blend_attachments);
 
-  range.setOffset(0);
-  range.setSize(this->m_push_constant_size);
-  range.setStageFlags(this->m_push_constant_flags);
-
   info.setSetLayoutCount(1);
   info.setPSetLayouts(&desc_layout);
-  info.setPushConstantRangeCount(1);
+  info.setPushConstantRangeCount(range.size > 0 ? 1 : 0);
   info.setPPushConstantRanges(&range);
 
   this->m_layout = error(this->m_device->gpu.createPipelineLayout(
@@ -25,6 +25,8 @@ class Pipeline {
   auto shader() const -> const Shader& { return *this->m_shader; }
   auto pipeline() const -> vk::Pipeline { return this->m_pipeline; }
   auto layout() const -> vk::PipelineLayout { return this->m_layout; }
+  auto push_constant_flags() const -> vk::ShaderStageFlags { return this->m_push_constant_flags; }
+  auto push_constant_size() const -> std::size_t { return this->m_push_constant_size; }
   auto bind_point() const -> vk::PipelineBindPoint {return this->graphics() ? vk::PipelineBindPoint::eGraphics : vk::PipelineBindPoint::eCompute;}
   auto valid() const  -> bool {return this->m_pipeline;}
  private:
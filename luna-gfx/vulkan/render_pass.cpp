@@ -234,6 +234,7 @@ auto RenderPass::bind() -> void {
         LunaAssert(attach.views.size() == num_buffers, "All images in a render pass must have the same buffering (all must be single/double/triple buffered).");
         auto handle = attach.views[index].handle();
         auto& img = res.images[handle];
+        img.attachment = true;
         views.push_back(img.view);
       };
     }
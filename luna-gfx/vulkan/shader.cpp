@@ -1,5 +1,6 @@
 #include "luna-gfx/vulkan/vulkan_defines.hpp"
 #include "luna-gfx/vulkan/shader.hpp"
+#include <algorithm>
 #include <fstream>
 #include <istream>
 #include <map>
@@ -110,6 +111,12 @@ auto convert(gfx::VariableType type) -> vk::DescriptorType {
     case gfx::VariableType::Storage:
       return vk::DescriptorType::eStorageBuffer;
       break;
+    case gfx::VariableType::UniformDynamic:
+      return vk::DescriptorType::eUniformBufferDynamic;
+      break;
+    case gfx::VariableType::StorateDynamic:
+      return vk::DescriptorType::eStorageBufferDynamic;
+      break;
     case gfx::VariableType::None:
       return vk::DescriptorType::eUniformBuffer;
       break;
@@ -209,6 +216,11 @@ auto Shader::parse() -> void {
         binding_map.insert(iter, {variable.first, binding});
       }
     }
+    if (stage.push_constant_size > 0) {
+      auto& range = this->m_push_constants;
+      range.setSize(std::max<uint32_t>(range.size, stage.push_constant_size));
+      range.setStageFlags(range.stageFlags | convert(stage.type));
+    }
     module_info.setCodeSize(stage.spirv.size() * sizeof(unsigned));
     module_info.setPCode(stage.spirv.data());
     this->m_spirv_map[convert(stage.type)] = module_info;
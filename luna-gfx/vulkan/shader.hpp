@@ -48,6 +48,11 @@ class Shader {
       -> const std::vector<vk::DescriptorSetLayoutBinding>& {
     return this->m_descriptors;
   }
+
+  // Covers every stage that reads push constants. Zero sized if none do.
+  inline auto pushConstants() const -> const vk::PushConstantRange& {
+    return this->m_push_constants;
+  }
  private:
   using SPIRVMap =
       std::map<vk::ShaderStageFlagBits, vk::ShaderModuleCreateInfo>;
@@ -68,6 +73,7 @@ class Shader {
   vk::DescriptorSetLayout m_layout;
   vk::PipelineVertexInputStateCreateInfo m_info;
   vk::VertexInputRate m_rate;
+  vk::PushConstantRange m_push_constants;
 
   inline auto parse() -> void;
   inline auto makeDescriptorLayout() -> void;
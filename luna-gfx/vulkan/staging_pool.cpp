@@ -0,0 +1,144 @@
+#include "luna-gfx/vulkan/vulkan_defines.hpp"
+#include "luna-gfx/vulkan/staging_pool.hpp"
+#include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/vulkan/data_types.hpp"
+#include "luna-gfx/vulkan/utils/helper_functions.hpp"
+#include "luna-gfx/error/error.hpp"
+#include <algorithm>
+#include <map>
+#include <utility>
+namespace luna {
+namespace vulkan {
+/** The calling thread's staging command buffer for each gpu. Only that thread ever touches it.
+ * When the thread exits they're destroyed, so they never hold its orphaned pool open or get handed to a later thread
+ * that happens to reuse its id.
+ */
+struct StagingCommands {
+  std::map<int, std::int32_t> cmds;
+
+  ~StagingCommands() {
+    auto& pools = global_resources().staging_pools;
+    for(auto& entry : this->cmds) {
+      if(static_cast<std::size_t>(entry.first) < pools.size()) pools[entry.first].forget(entry.second);
+    }
+  }
+};
+
+static thread_local StagingCommands staging_commands;
+
+// Big enough that thousands of small uploads share a single chunk.
+constexpr auto cChunkSize = std::size_t(8) * 1024 * 1024;
+
+// Covers the texel size of every gfx::ImageFormat, as buffer to image copies need their offset aligned to it.
+constexpr auto cMinAlignment = std::size_t(16);
+
+StagingPool::StagingPool(StagingPool&& mv) {
+  *this = std::move(mv);
+}
+
+auto StagingPool::operator=(StagingPool&& mv) -> StagingPool& {
+  this->m_chunks = std::move(mv.m_chunks);
+  this->m_cmds = std::move(mv.m_cmds);
+  return *this;
+}
+
+auto StagingPool::allocate(int gpu, std::size_t size) -> Allocation {
+  auto& res = global_resources();
+  auto alignment = std::max<std::size_t>(cMinAlignment, res.devices[gpu].properties.limits.optimalBufferCopyOffsetAlignment);
+  auto aligned = ((size + alignment - 1) / alignment) * alignment;
+
+  auto lock = std::scoped_lock(this->m_lock);
+  auto chunk = this->m_chunks.end();
+  for(auto iter = this->m_chunks.begin(); iter != this->m_chunks.end();) {
+    if(iter->head + aligned > iter->size && this->reclaimable(gpu, *iter)) {
+      // Oversized chunks only exist for one-off large uploads, so give their memory back rather than hold on to it.
+      if(iter->size > cChunkSize) {
+        destroy_buffer(iter->buffer);
+        iter = this->m_chunks.erase(iter);
+        continue;
+      }
+      iter->head = 0;
+    }
+
+    if(iter->head + aligned <= iter->size) {
+      chunk = iter;
+      break;
+    }
+    ++iter;
+  }
+
+  if(chunk == this->m_chunks.end()) {
+    auto new_chunk = Chunk();
+    new_chunk.size = std::max(cChunkSize, aligned);
+    new_chunk.buffer = create_buffer(gpu, new_chunk.size, vk::BufferUsageFlagBits::eTransferSrc, HostAccess::SequentialWrite);
+    new_chunk.data = static_cast<unsigned char*>(res.buffers[new_chunk.buffer].mapped);
+    chunk = this->m_chunks.insert(this->m_chunks.end(), new_chunk);
+  }
+
+  auto alloc = Allocation();
+  alloc.buffer = chunk->buffer;
+  alloc.offset = chunk->head;
+  alloc.data = chunk->data + chunk->head;
+  alloc.size = size;
+  chunk->head += aligned;
+  chunk->live++;
+  return alloc;
+}
+
+auto StagingPool::release(const Allocation& alloc, std::uint64_t serial) -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  for(auto& chunk : this->m_chunks) {
+    if(chunk.buffer != alloc.buffer) continue;
+    LunaAssert(chunk.live > 0, "Releasing a staging allocation twice.");
+    chunk.live--;
+    chunk.serial = std::max(chunk.serial, serial);
+    return;
+  }
+}
+
+auto StagingPool::command_buffer(int gpu) -> std::int32_t {
+  auto iter = staging_commands.cmds.find(gpu);
+  if(iter != staging_commands.cmds.end()) return iter->second;
+
+  // Made here, so it comes out of this thread's own pool.
+  auto cmd = create_cmd(gpu);
+  staging_commands.cmds.emplace(gpu, cmd);
+  auto lock = std::scoped_lock(this->m_lock);
+  this->m_cmds.push_back(cmd);
+  return cmd;
+}
+
+auto StagingPool::forget(std::int32_t cmd) -> void {
+  {
+    auto lock = std::scoped_lock(this->m_lock);
+    auto iter = std::find(this->m_cmds.begin(), this->m_cmds.end(), cmd);
+    if(iter == this->m_cmds.end()) return;
+    this->m_cmds.erase(iter);
+  }
+
+  // Unlocked, since collecting can run deleters that come back into the pool.
+  defer_destroy_cmd(cmd);
+}
+
+auto StagingPool::clear() -> void {
+  auto lock = std::scoped_lock(this->m_lock);
+  for(auto cmd : this->m_cmds) destroy_cmd(cmd);
+  for(auto& chunk : this->m_chunks) destroy_buffer(chunk.buffer);
+  this->m_cmds.clear();
+  this->m_chunks.clear();
+}
+
+auto StagingPool::capacity() const -> std::size_t {
+  auto lock = std::scoped_lock(this->m_lock);
+  auto bytes = std::size_t(0);
+  for(const auto& chunk : this->m_chunks) bytes += chunk.size;
+  return bytes;
+}
+
+// Must be called with the lock held.
+auto StagingPool::reclaimable(int gpu, const Chunk& chunk) -> bool {
+  auto& res = global_resources();
+  return chunk.live == 0 && res.deletion_queues[gpu].is_complete(res.devices[gpu], chunk.serial);
+}
+}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+namespace luna {
+namespace vulkan {
+/** Host-visible scratch memory for getting data into device-local buffers & images.
+ * Memory comes out of a few large persistently mapped chunks, each one bump allocated. A chunk is reused once every
+ * allocation from it has been released and the last submission that read from it has retired.
+ * Also keeps one command buffer per thread for recording the copies, so staging never creates any per upload. Each is
+ * made from its thread's own command pool, and destroyed once the thread exits.
+ */
+class StagingPool {
+  public:
+    struct Allocation {
+      std::int32_t buffer = -1;    // Handle of the chunk's buffer.
+      std::size_t offset = 0;      // Where in that buffer this allocation starts.
+      unsigned char* data = nullptr;
+      std::size_t size = 0;
+    };
+
+    StagingPool() = default;
+    StagingPool(StagingPool&& mv);
+    StagingPool(const StagingPool& cpy) = delete;
+    ~StagingPool() = default;
+    auto operator=(StagingPool&& mv) -> StagingPool&;
+    auto operator=(const StagingPool& cpy) -> StagingPool& = delete;
+
+    // Grabs `size` bytes of mapped memory, suitably aligned as the source of a buffer or image copy.
+    [[nodiscard]] auto allocate(int gpu, std::size_t size) -> Allocation;
+
+    // Hands an allocation back. Its memory gets reused once the given submission has finished.
+    auto release(const Allocation& alloc, std::uint64_t serial) -> void;
+
+    // The command buffer the calling thread records its staged copies into.
+    [[nodiscard]] auto command_buffer(int gpu) -> std::int32_t;
+
+    // Destroys an exited thread's command buffer once its last submit is done, unless clear() already has.
+    auto forget(std::int32_t cmd) -> void;
+
+    // Destroys every chunk & command buffer. Only for when the device is known to be idle.
+    auto clear() -> void;
+
+    // Bytes of staging memory currently held.
+    [[nodiscard]] auto capacity() const -> std::size_t;
+
+  private:
+    struct Chunk {
+      std::int32_t buffer = -1;
+      unsigned char* data = nullptr;
+      std::size_t size = 0;
+      std::size_t head = 0;
+      std::size_t live = 0;      // Allocations that haven't been released yet.
+      std::uint64_t serial = 0;  // Latest submission that read from this chunk.
+    };
+
+    auto reclaimable(int gpu, const Chunk& chunk) -> bool;
+
+    mutable std::mutex m_lock;
+    std::vector<Chunk> m_chunks;
+    std::vector<std::int32_t> m_cmds; // Every live thread's, so clear() can get the ones still around.
+};
+}
+}
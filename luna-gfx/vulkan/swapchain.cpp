@@ -270,7 +270,11 @@ auto Swapchain::present() -> void {
   info.setSwapchainCount(1);
   info.setPSwapchains(&chain);
   info.setWaitSemaphores(wait_sems);
-  auto result = queue.presentKHR(&info, gpu.m_dispatch);
+  auto result = vk::Result();
+  {
+    auto lock = std::scoped_lock(gpu.queue_lock(queue));
+    result = queue.presentKHR(&info, gpu.m_dispatch);
+  }
   if(result != vk::Result::eSuccess) {
     gpu.wait_idle();
     this->recreate();
@@ -10,8 +10,12 @@
 #include "luna-gfx/interface/pipeline.hpp"
 #include "luna-gfx/interface/command_list.hpp"
 #include "luna-gfx/vulkan/global_resources.hpp"
+#include "luna-gfx/common/streaming_copy.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstring>
 #include <array>
+#include <mutex>
 namespace luna {
 namespace vulkan {
 inline auto convert(luna::gfx::ImageFormat fmt) -> vk::Format {
@@ -74,11 +78,30 @@ inline auto synchronize_cmd(int32_t cmd_id) -> void {
   auto& cmd = luna::vulkan::global_resources().cmds[cmd_id];
   auto& gpu = luna::vulkan::global_resources().devices[cmd.gpu];
   
-  if(cmd.fence && cmd.signaled) {
-    error(gpu.gpu.waitForFences(1, &cmd.fence, true, UINT64_MAX, gpu.m_dispatch));
-    error(gpu.gpu.resetFences(1, &cmd.fence, gpu.m_dispatch));
+  if(cmd.signaled) {
+    auto info = vk::SemaphoreWaitInfo();
+    info.setSemaphoreCount(1);
+    info.setPSemaphores(&cmd.timeline);
+    info.setPValues(&cmd.point);
+    error(gpu.gpu.waitSemaphores(info, UINT64_MAX, gpu.m_dispatch));
     cmd.signaled = false;
   }
+
+  // Whatever the callbacks touch may be reused once this returns, so they have to have finished too.
+  if(cmd.awaiting_callbacks) {
+    luna::vulkan::global_resources().completion_services[cmd.gpu].settle(cmd.timeline, cmd.point);
+    cmd.awaiting_callbacks = false;
+  }
+}
+
+// The serial of the last submit to run a list. A secondary's is set by whichever thread submits its parent, under the
+// queue's lock, so it's read under that lock too.
+inline auto last_serial(int32_t handle) -> std::uint64_t {
+  auto& res = luna::vulkan::global_resources();
+  auto& cmd = res.cmds[handle];
+  if(cmd.parent < 0) return cmd.serial;
+  auto lock = std::scoped_lock(res.devices[cmd.gpu].queue_owner(cmd.queue).lock);
+  return cmd.serial;
 }
 
 inline auto begin_command_buffer(int32_t handle) -> void {
@@ -86,7 +109,34 @@ inline auto begin_command_buffer(int32_t handle) -> void {
   auto& cmd = luna::vulkan::global_resources().cmds[handle];
   auto& gpu = luna::vulkan::global_resources().devices[cmd.gpu];
   luna::vulkan::synchronize_cmd(handle);
-  luna::vulkan::error(cmd.cmd.begin(cmd.begin_info, gpu.m_dispatch));
+  cmd.layout = nullptr;
+  cmd.executed.clear();
+  cmd.images.clear();
+  if(!cmd.recording) luna::vulkan::global_resources().defragmenters[cmd.gpu].began_recording();
+  cmd.recording = true;
+  if(cmd.parent < 0) {
+    luna::vulkan::error(cmd.cmd.begin(cmd.begin_info, gpu.m_dispatch));
+    return;
+  }
+
+  // Secondaries are never submitted themselves, so wait on the last submit that ran them instead.
+  auto& res = luna::vulkan::global_resources();
+  auto serial = last_serial(handle);
+  if(serial) res.deletion_queues[cmd.gpu].wait(gpu, serial);
+
+  // Continue whatever render pass the parent is in right now.
+  auto& parent = res.cmds[cmd.parent];
+  auto inheritance = vk::CommandBufferInheritanceInfo();
+  auto info = cmd.begin_info;
+  if(parent.rp_id >= 0) {
+    auto& rp = res.render_passes[parent.rp_id];
+    inheritance.setRenderPass(rp.pass());
+    inheritance.setSubpass(parent.subpass);
+    inheritance.setFramebuffer(rp.framebuffers()[parent.framebuffer]);
+    info.setFlags(info.flags | vk::CommandBufferUsageFlagBits::eRenderPassContinue);
+  }
+  info.setPInheritanceInfo(&inheritance);
+  luna::vulkan::error(cmd.cmd.begin(info, gpu.m_dispatch));
 }
 
 inline auto end_command_buffer(int32_t handle) -> void {
@@ -94,6 +144,8 @@ inline auto end_command_buffer(int32_t handle) -> void {
   auto& cmd = luna::vulkan::global_resources().cmds[handle];
   auto& gpu = luna::vulkan::global_resources().devices[cmd.gpu];
   luna::vulkan::error(cmd.cmd.end(gpu.m_dispatch));
+  if(cmd.recording) luna::vulkan::global_resources().defragmenters[cmd.gpu].ended_recording();
+  cmd.recording = false;
 }
 
 inline auto create_semaphores(int gpu_id, size_t amount) {
@@ -102,9 +154,15 @@ inline auto create_semaphores(int gpu_id, size_t amount) {
 
   auto tmp = std::vector<int32_t>(amount);
 
-  for(auto& sem : tmp) {
-    sem = find_valid_entry(sems);
-    sems[sem].in_use = true;
+  for(auto& handle : tmp) {
+    handle = sems.acquire();
+
+    // Semaphores stay alive in their slot once made, so only create one the first time a slot is used.
+    auto& sem = sems[handle];
+    if(!sem.sem) {
+      auto& gpu = res.devices[gpu_id];
+      sem.sem = error(gpu.gpu.createSemaphore(vk::SemaphoreCreateInfo(), gpu.allocate_cb, gpu.m_dispatch));
+    }
   }
 
   return tmp;
@@ -128,38 +186,78 @@ inline auto release_semaphores(int gpu_id, const std::vector<int32_t>& in_sems)
   auto& sems = res.semaphores[gpu_id];
 
   for(auto sem : in_sems) {
-    sems[sem].in_use = false;
+    sems.release(sem);
   }
   return {};
 }
 
-inline auto create_cmd(int gpu, gfx::Queue type = gfx::Queue::All, CommandBuffer* parent = nullptr) -> int32_t {
-  auto& res = global_resources();
-  auto index = find_valid_entry(res.cmds);
-  auto& cmd = res.cmds[index];
-  auto& device = res.devices[gpu];
-  auto info = vk::CommandBufferAllocateInfo();
-  auto fence_info = vk::FenceCreateInfo();
-  
-  auto queue = device.graphics().queue;
-  auto queue_id = device.graphics().id;
+inline auto device_queue(Device& device, gfx::Queue type) -> Queue& {
   switch(type) {
-    case gfx::Queue::Compute : queue_id = device.compute().id; queue = device.compute().queue; break;
-    case gfx::Queue::Transfer : queue_id = device.transfer().id; queue = device.transfer().queue; break;
+    case gfx::Queue::Compute : return device.compute();
+    case gfx::Queue::Transfer : return device.transfer();
     case gfx::Queue::All :  [[fallthrough]];
     case gfx::Queue::Graphics : [[fallthrough]];
-    default: queue_id = device.graphics().id; queue = device.graphics().queue; break;
+    default: return device.graphics();
   }
+}
 
-  auto pool = create_pool(device, queue_id);
+// The timeline semaphore submits to that queue signal.
+inline auto queue_timeline(int gpu, gfx::Queue type) -> vk::Semaphore {
+  auto& device = global_resources().devices[gpu];
+  return device.queue_owner(device_queue(device, type).queue).timeline;
+}
+
+// A pool whose command buffers are only ever reset all at once, with reset_transient_pool().
+inline auto create_transient_pool(int gpu, gfx::Queue type) -> vk::CommandPool {
+  auto& device = global_resources().devices[gpu];
+  auto info = vk::CommandPoolCreateInfo();
+  info.setFlags(vk::CommandPoolCreateFlagBits::eTransient);
+  info.setQueueFamilyIndex(device_queue(device, type).id);
+  return error(device.gpu.createCommandPool(info, device.allocate_cb, device.m_dispatch));
+}
+
+// Resets every command buffer allocated from the pool, handing their memory back to it. None can be in flight.
+inline auto reset_transient_pool(int gpu, vk::CommandPool pool) -> void {
+  auto& device = global_resources().devices[gpu];
+  error(device.gpu.resetCommandPool(pool, {}, device.m_dispatch));
+}
+
+inline auto destroy_transient_pool(int gpu, vk::CommandPool pool) -> void {
+  auto& device = global_resources().devices[gpu];
+  device.gpu.destroy(pool, device.allocate_cb, device.m_dispatch);
+}
+
+// Without a `transient_pool`, allocates from the calling thread's pool for the queue.
+inline auto create_cmd(int gpu, gfx::Queue type = gfx::Queue::All, int32_t parent = -1, vk::CommandPool transient_pool = {}) -> int32_t {
+  auto& res = global_resources();
+  auto index = res.cmds.acquire();
+  auto& cmd = res.cmds[index];
+  auto& device = res.devices[gpu];
+  auto info = vk::CommandBufferAllocateInfo();
+  
+  auto& device_q = device_queue(device, type);
+  auto queue = device_q.queue;
+  auto thread_pool = transient_pool ? nullptr : create_pool(device, device_q.id);
+  auto pool = transient_pool ? transient_pool : thread_pool->pool;
   info.setCommandBufferCount(1);
   info.setCommandPool(pool);
-  info.setLevel(parent ? vk::CommandBufferLevel::eSecondary : vk::CommandBufferLevel::ePrimary);
-  cmd.cmd = error(device.gpu.allocateCommandBuffers(info, device.m_dispatch)).data()[0];
-  cmd.fence = error(device.gpu.createFence(fence_info, device.allocate_cb, device.m_dispatch));
+  info.setLevel(parent >= 0 ? vk::CommandBufferLevel::eSecondary : vk::CommandBufferLevel::ePrimary);
+  if(thread_pool) {
+    // Only other threads destroying this pool's lists ever contend for the lock.
+    auto lock = std::scoped_lock(thread_pool->lock);
+    if(!thread_pool->garbage.empty()) device.gpu.freeCommandBuffers(pool, thread_pool->garbage, device.m_dispatch);
+    thread_pool->garbage.clear();
+    cmd.cmd = error(device.gpu.allocateCommandBuffers(info, device.m_dispatch)).data()[0];
+    thread_pool->live++;
+  } else {
+    cmd.cmd = error(device.gpu.allocateCommandBuffers(info, device.m_dispatch)).data()[0];
+  }
   cmd.queue = queue;
+  cmd.timeline = device.queue_owner(queue).timeline;
   cmd.gpu = gpu;
   cmd.pool = pool;
+  cmd.parent = parent;
+  cmd.thread_pool = std::move(thread_pool);
   return index;
 }
 
@@ -168,6 +266,8 @@ inline auto destroy_cmd(int32_t handle) -> void {
   auto& cmd = res.cmds[handle];
   auto& gpu = res.devices[cmd.gpu];
   synchronize_cmd(handle);
+  if(cmd.recording) res.defragmenters[cmd.gpu].ended_recording();
+  cmd.recording = false;
   if(cmd.timestamp_pool) {
     gpu.gpu.destroy(cmd.timestamp_pool, gpu.allocate_cb, gpu.m_dispatch);
     cmd.timestamp_pool = nullptr;
@@ -175,12 +275,35 @@ inline auto destroy_cmd(int32_t handle) -> void {
   release_semaphores(cmd.gpu, cmd.sems_to_wait_on);
   cmd.sems_to_signal.clear();
   cmd.sems_to_wait_on.clear();
-  gpu.gpu.destroy(cmd.fence, gpu.allocate_cb, gpu.m_dispatch);
-  gpu.gpu.freeCommandBuffers(cmd.pool, 1, &cmd.cmd, gpu.m_dispatch);
+  cmd.timeline_waits.clear();
+  cmd.images.clear();
+
+  // Never submitted again, so there's nothing left for the lists combo'd from this one to wait on.
+  for(auto target : cmd.combos) {
+    if(res.cmds.valid(target)) res.cmds[target].pending_combos--;
+  }
+  cmd.combos.clear();
+  cmd.pending_combos = 0;
+  for(auto& callback : cmd.on_complete) callback(false);
+  cmd.on_complete.clear();
+  if(cmd.thread_pool) {
+    auto& pool = *cmd.thread_pool;
+    auto lock = std::scoped_lock(pool.lock);
+    pool.live--;
+    if(pool.orphaned && pool.live == 0) destroy_orphaned_pool(gpu, pool);
+    else if(pool.orphaned || pool.owner == std::this_thread::get_id()) gpu.gpu.freeCommandBuffers(pool.pool, 1, &cmd.cmd, gpu.m_dispatch);
+    else pool.garbage.push_back(cmd.cmd);
+  }
+  cmd.thread_pool = nullptr;
   cmd.cmd = nullptr;
+  cmd.parent = -1;
+  cmd.rp_id = -1;
+  cmd.executed.clear();
+  res.cmds.release(handle);
 }
 
-inline auto cmd_start_render_pass(int32_t cmd_handle, int32_t rp_handle, size_t framebuffer_id) -> void {
+// With `secondaries`, the first subpass is recorded into secondary command buffers instead of inline.
+inline auto cmd_start_render_pass(int32_t cmd_handle, int32_t rp_handle, size_t framebuffer_id, bool secondaries = false) -> void {
   auto& res = global_resources();
   auto& cmd = res.cmds[cmd_handle];
   auto& gpu = res.devices[cmd.gpu];
@@ -188,12 +311,20 @@ inline auto cmd_start_render_pass(int32_t cmd_handle, int32_t rp_handle, size_t
 
   //const auto& curr_subpass = rp.current_subpass();
   auto info = vk::RenderPassBeginInfo();
-  auto subpass = vk::SubpassContents::eInline;
+  auto subpass = secondaries ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline;
+  cmd.rp_id = rp_handle;
+  cmd.framebuffer = framebuffer_id;
+  cmd.subpass = 0;
   info.setRenderArea(rp.area());
   info.setRenderPass(rp.pass());
   info.setClearValues(rp.clear_values());
   info.setFramebuffer(rp.framebuffers()[framebuffer_id]);
   cmd.cmd.beginRenderPass(info, subpass, gpu.m_dispatch);
+  for(const auto& pass : rp.subpasses()) {
+    for(const auto& attachment : pass.luna_attachments) {
+      if(framebuffer_id < attachment.views.size()) cmd.images.push_back(attachment.views[framebuffer_id].handle());
+    }
+  }
 }
 
 inline auto cmd_end_render_pass(int32_t cmd_handle) -> void {
@@ -201,17 +332,35 @@ inline auto cmd_end_render_pass(int32_t cmd_handle) -> void {
   auto& cmd = res.cmds[cmd_handle];
   auto& gpu = res.devices[cmd.gpu];
   cmd.cmd.endRenderPass(gpu.m_dispatch);
+  cmd.rp_id = -1;
 }
 
-inline auto cmd_next_subpass(int32_t cmd_handle) -> void {
-  auto contents = vk::SubpassContents::eInline;
+inline auto cmd_next_subpass(int32_t cmd_handle, bool secondaries = false) -> void {
+  auto contents = secondaries ? vk::SubpassContents::eSecondaryCommandBuffers : vk::SubpassContents::eInline;
   auto& res = global_resources();
   auto& cmd = res.cmds[cmd_handle];
   auto& gpu = res.devices[cmd.gpu];
   cmd.cmd.nextSubpass(contents, gpu.m_dispatch);
+  cmd.subpass++;
+}
+
+// Runs secondary command buffers. They're kept alive until this one's next submit is done with them.
+inline auto cmd_execute(int32_t cmd_handle, const std::vector<int32_t>& secondaries) -> void {
+  auto& res = global_resources();
+  auto& cmd = res.cmds[cmd_handle];
+  auto& gpu = res.devices[cmd.gpu];
+  auto buffers = std::vector<vk::CommandBuffer>();
+  buffers.reserve(secondaries.size());
+  for(auto handle : secondaries) {
+    LunaAssert(res.cmds[handle].parent >= 0, "Only secondary command lists can be executed from another list.");
+    buffers.push_back(res.cmds[handle].cmd);
+    cmd.executed.push_back(handle);
+    cmd.images.insert(cmd.images.end(), res.cmds[handle].images.begin(), res.cmds[handle].images.end());
+  }
+  if(!buffers.empty()) cmd.cmd.executeCommands(buffers, gpu.m_dispatch);
 }
 
-inline auto cmd_bind_descriptor(int32_t cmd_handle, int32_t desc_handle) -> void {
+inline auto cmd_bind_descriptor(int32_t cmd_handle, int32_t desc_handle, const std::vector<std::uint32_t>& dynamic_offsets = {}) -> void {
   auto& res = global_resources();
   auto& cmd = res.cmds[cmd_handle];
   auto& gpu = res.devices[cmd.gpu];
@@ -224,8 +373,21 @@ inline auto cmd_bind_descriptor(int32_t cmd_handle, int32_t desc_handle) -> void
                                               : vk::PipelineBindPoint::eCompute;
 
   cmd.cmd.bindPipeline(bind_point, vk_pipe, gpu.m_dispatch);
+  cmd.layout = layout;
+  cmd.push_stages = pipeline.push_constant_flags();
+  cmd.push_size = pipeline.push_constant_size();
+  desc.bound_images(cmd.images);
   if (desc.set())
-    cmd.cmd.bindDescriptorSets(bind_point, layout, 0, 1, &desc.set(), 0, nullptr, gpu.m_dispatch);
+    cmd.cmd.bindDescriptorSets(bind_point, layout, 0, 1, &desc.set(), dynamic_offsets.size(), dynamic_offsets.data(), gpu.m_dispatch);
+}
+
+inline auto cmd_push_constants(int32_t cmd_handle, const void* data, std::size_t size, std::size_t offset) -> void {
+  auto& res = global_resources();
+  auto& cmd = res.cmds[cmd_handle];
+  auto& gpu = res.devices[cmd.gpu];
+  LunaAssert(cmd.layout, "Push constants need a bind group bound first, to know the pipeline layout.");
+  LunaAssert(offset + size <= cmd.push_size, "Push constants go past the pipeline's push constant range.");
+  cmd.cmd.pushConstants(cmd.layout, cmd.push_stages, offset, size, data, gpu.m_dispatch);
 }
 
 inline auto cmd_buffer_dispatch(int32_t cmd_handle, size_t x, size_t y, size_t z) -> void {
@@ -235,28 +397,28 @@ inline auto cmd_buffer_dispatch(int32_t cmd_handle, size_t x, size_t y, size_t z
   cmd.cmd.dispatch(x, y, z, gpu.m_dispatch);
 }
 
-inline auto cmd_buffer_draw(int32_t cmd_handle, int32_t vertices_id, size_t vertex_count, size_t instance_count) -> void {
+inline auto cmd_buffer_draw(int32_t cmd_handle, int32_t vertices_id, size_t vertex_count, size_t instance_count, size_t vertex_offset = 0) -> void {
   auto& res = global_resources();
   auto& cmd = res.cmds[cmd_handle];
   auto& gpu = res.devices[cmd.gpu];
   auto& vertices = res.buffers[vertices_id];
 
-  auto offset = vk::DeviceSize(0);
+  auto offset = vk::DeviceSize(vertex_offset);
   cmd.cmd.bindVertexBuffers(0, 1, &vertices.buffer, &offset, gpu.m_dispatch);
   cmd.cmd.draw(vertex_count, instance_count, 0, 0, gpu.m_dispatch);
 }
 
-inline auto cmd_buffer_draw(int32_t cmd_handle, int32_t vertices_id, size_t vertex_count, int32_t indices_id,  size_t idx_count, size_t instance_count) -> void {
+inline auto cmd_buffer_draw(int32_t cmd_handle, int32_t vertices_id, size_t vertex_count, int32_t indices_id,  size_t idx_count, size_t instance_count, size_t vertex_offset = 0, size_t index_offset = 0) -> void {
   auto& res = global_resources();
   auto& cmd = res.cmds[cmd_handle];
   auto& gpu = res.devices[cmd.gpu];
   auto& vertices = res.buffers[vertices_id];
   auto& indices = res.buffers[indices_id];
 
-  auto offset = vk::DeviceSize(0);
+  auto offset = vk::DeviceSize(vertex_offset);
   auto index_type = vk::IndexType::eUint32;
   cmd.cmd.bindVertexBuffers(0, 1, &vertices.buffer, &offset, gpu.m_dispatch);
-  cmd.cmd.bindIndexBuffer(indices.buffer, offset, index_type, gpu.m_dispatch);
+  cmd.cmd.bindIndexBuffer(indices.buffer, vk::DeviceSize(index_offset), index_type, gpu.m_dispatch);
   cmd.cmd.drawIndexed(idx_count, instance_count, 0, 0, 0, gpu.m_dispatch);
 }
 
@@ -279,53 +441,155 @@ inline auto end_timestamp(int32_t cmd_handle, vk::PipelineStageFlagBits stage) -
   cmd.cmd.writeTimestamp(stage, cmd.timestamp_pool, 1, gpu.m_dispatch);
 }
 
-inline auto read_timestamp(int32_t cmd_handle) -> std::chrono::duration<double, std::nano> {
+// Takes the pool rather than the list, so it can be read from the completion thread without touching the list.
+inline auto read_timestamp(int gpu_id, vk::QueryPool pool) -> std::chrono::duration<double, std::nano> {
   static_assert(sizeof(double) == 8);
   constexpr auto flags = vk::QueryResultFlagBits::e64 | vk::QueryResultFlagBits::eWait;
-  auto& cmd = luna::vulkan::global_resources().cmds[cmd_handle];
-  auto& gpu = luna::vulkan::global_resources().devices[cmd.gpu];
+  auto& gpu = luna::vulkan::global_resources().devices[gpu_id];
   auto tmp_storage = std::array<int64_t, 2> {0, 0};
-  error(gpu.gpu.getQueryPoolResults(cmd.timestamp_pool, 0, 2, sizeof(double) * 2, &tmp_storage[0], sizeof(double), flags, gpu.m_dispatch));
+  error(gpu.gpu.getQueryPoolResults(pool, 0, 2, sizeof(double) * 2, &tmp_storage[0], sizeof(double), flags, gpu.m_dispatch));
 
   auto duration = static_cast<double>(tmp_storage[1] - tmp_storage[0]) * gpu.properties.limits.timestampPeriod;
   return std::chrono::duration<double, std::nano>(duration);
 }
 
-inline auto submit_command_buffer(int32_t handle) -> void {
-  auto& cmd = luna::vulkan::global_resources().cmds[handle];
-  auto& gpu = luna::vulkan::global_resources().devices[cmd.gpu];
-  auto& info = cmd.submit_info;
-  auto& queue = cmd.queue;
+inline auto read_timestamp(int32_t cmd_handle) -> std::chrono::duration<double, std::nano> {
+  auto& cmd = luna::vulkan::global_resources().cmds[cmd_handle];
+  return read_timestamp(cmd.gpu, cmd.timestamp_pool);
+}
 
-  auto vector = std::vector<vk::Semaphore>();
-  auto masks = std::vector<vk::PipelineStageFlags>();
-  
-  if(cmd.fence && cmd.signaled) {
-    error(gpu.gpu.waitForFences(1, &cmd.fence, true, UINT64_MAX, gpu.m_dispatch));
-    error(gpu.gpu.resetFences(1, &cmd.fence, gpu.m_dispatch));
+// Submits every list in one vkQueueSubmit, so a frame's lists only pay for one trip into the driver. They all have
+// to go to the same queue. Each still signals its own point, in order, so lists can combo into later ones in the batch.
+inline auto submit_command_buffers(const std::vector<int32_t>& handles) -> void {
+  if(handles.empty()) return;
+  auto& res = luna::vulkan::global_resources();
+  auto gpu_id = res.cmds[handles.front()].gpu;
+  auto queue = res.cmds[handles.front()].queue;
+  auto& gpu = res.devices[gpu_id];
+  auto& deletion_queue = res.deletion_queues[gpu_id];
+  auto& owner = gpu.queue_owner(queue);
+
+  // Everything a SubmitInfo points at has to stay put until the submit.
+  struct Submit {
+    std::vector<vk::Semaphore> wait_sems;
+    std::vector<vk::Semaphore> signal_sems;
+    std::vector<std::uint64_t> wait_values;
+    std::vector<std::uint64_t> signal_values;
+    std::vector<vk::PipelineStageFlags> masks;
+    vk::TimelineSemaphoreSubmitInfo timeline_info;
+  };
+  auto submits = std::vector<Submit>(handles.size());
+  auto infos = std::vector<vk::SubmitInfo>(handles.size());
+
+  // A list can't be resubmitted while its last submit is still running.
+  for(auto handle : handles) synchronize_cmd(handle);
+
+  // Buffers & images being moved by the defragmenter may already be swapped for ones its copies are still filling.
+  auto copy = res.defragmenters[gpu_id].pending_copy();
+  {
+    // Points have to be signaled in the order they're handed out, so they're handed out under the queue's lock.
+    auto lock = std::scoped_lock(owner.lock);
+    for(auto index = 0u; index < handles.size(); index++) {
+      auto& cmd = res.cmds[handles[index]];
+      auto& submit = submits[index];
+      auto& info = infos[index];
+      LunaAssert(cmd.gpu == gpu_id && &gpu.queue_owner(cmd.queue) == &owner, "Every list in a batch has to go to the same queue.");
+      LunaAssert(cmd.parent < 0, "Secondary command lists can only be run through execute().");
+
+      // Binary semaphores ignore their values, but still need a slot in the value arrays.
+      submit.wait_sems = vk_sems_from_ids(cmd.gpu, cmd.sems_to_wait_on);
+      submit.signal_sems = vk_sems_from_ids(cmd.gpu, cmd.sems_to_signal);
+      submit.wait_values.resize(submit.wait_sems.size(), 0);
+      submit.signal_values.resize(submit.signal_sems.size(), 0);
+      LunaAssert(cmd.pending_combos == 0, "A command list has to be submitted before the lists it was combo'd into.");
+      for(auto& wait : cmd.timeline_waits) {
+        submit.wait_sems.push_back(wait.first);
+        submit.wait_values.push_back(wait.second);
+      }
+      if(copy.first) {
+        submit.wait_sems.push_back(copy.first);
+        submit.wait_values.push_back(copy.second);
+      }
+
+      cmd.point = ++owner.value;
+      cmd.serial = deletion_queue.submitted(owner.timeline, cmd.point);
+
+      // Queues submit concurrently, so a later serial may already be in.
+      for(auto image : cmd.images) {
+        if(!res.images.valid(image)) continue;
+        auto& last_use = res.images[image].last_use;
+        auto used = last_use.load();
+        while(used < cmd.serial && !last_use.compare_exchange_weak(used, cmd.serial)) {}
+      }
+      submit.signal_sems.push_back(owner.timeline);
+      submit.signal_values.push_back(cmd.point);
+
+      // Hand the point to the lists combo'd from this one, so they wait on exactly this submit.
+      for(auto target : cmd.combos) {
+        if(!res.cmds.valid(target)) continue;
+        auto& other = res.cmds[target];
+        other.timeline_waits.push_back({owner.timeline, cmd.point});
+        other.pending_combos--;
+      }
+      cmd.combos.clear();
+      submit.masks.resize(submit.wait_sems.size(), vk::PipelineStageFlagBits::eAllCommands);
+      submit.timeline_info.setWaitSemaphoreValues(submit.wait_values);
+      submit.timeline_info.setSignalSemaphoreValues(submit.signal_values);
+      info.setCommandBufferCount(1);
+      info.setPCommandBuffers(&cmd.cmd);
+      info.setWaitSemaphores(submit.wait_sems);
+      info.setWaitDstStageMask(submit.masks);
+      info.setSignalSemaphores(submit.signal_sems);
+      info.setPNext(&submit.timeline_info);
+    }
+    error(queue.submit(infos.size(), infos.data(), nullptr, gpu.m_dispatch));
+
+    // Secondaries can be recording again on other threads, so theirs are only touched under the lock.
+    for(auto handle : handles) {
+      auto& cmd = res.cmds[handle];
+      for(auto secondary : cmd.executed) res.cmds[secondary].serial = cmd.serial;
+    }
   }
 
-  auto wait_sems = vk_sems_from_ids(cmd.gpu, cmd.sems_to_wait_on);
-  auto signal_sems = vk_sems_from_ids(cmd.gpu, cmd.sems_to_signal);
+  for(auto handle : handles) {
+    auto& cmd = res.cmds[handle];
 
-  masks.resize(wait_sems.size());
-  for(auto& mask : masks) mask = vk::PipelineStageFlagBits::eTopOfPipe;
+    // Release the sems that were just consumed.
+    release_semaphores(cmd.gpu, cmd.sems_to_wait_on); 
+    cmd.sems_to_wait_on.clear();
+    cmd.sems_to_signal.clear();
+    cmd.timeline_waits.clear();
+    cmd.signaled = true;
 
-  info.setCommandBufferCount(1);
-  info.setPCommandBuffers(&cmd.cmd);
-  info.setWaitSemaphores(wait_sems);
-  info.setSignalSemaphores(signal_sems);
-  info.setWaitDstStageMask(masks);
+    for(auto& callback : cmd.on_complete) {
+      res.completion_services[gpu_id].watch(gpu_id, cmd.timeline, cmd.point, [callback = std::move(callback)]() {callback(true);});
+    }
+    cmd.awaiting_callbacks = !cmd.on_complete.empty();
+    cmd.on_complete.clear();
+  }
 
-  if(wait_sems.size() > 0)
-    LunaAssert(info.waitSemaphoreCount > 0, "WTF");
-  error(queue.submit(1, &info, cmd.fence, gpu.m_dispatch));
+  // Good time to reclaim anything whose work has since finished.
+  deletion_queue.collect(gpu);
+}
 
-  // Release the sems that were just consumed.
-  release_semaphores(cmd.gpu, cmd.sems_to_wait_on); 
-  cmd.sems_to_wait_on.clear();
-  cmd.sems_to_signal.clear();
-  cmd.signaled = true;
+inline auto submit_command_buffer(int32_t handle) -> void {
+  submit_command_buffers({handle});
+}
+
+// Destroys something once all work submitted to the gpu so far has finished, without waiting on it.
+inline auto defer_destruction(int gpu, DeletionQueue::Deleter deleter) -> void {
+  auto& res = global_resources();
+  res.deletion_queues[gpu].defer(std::move(deleter));
+  res.deletion_queues[gpu].collect(res.devices[gpu]);
+}
+
+// Destroys a command buffer once its last submission has finished, without waiting on it.
+inline auto defer_destroy_cmd(int32_t handle) -> void {
+  auto& res = global_resources();
+  auto& cmd = res.cmds[handle];
+  auto gpu = cmd.gpu;
+  res.deletion_queues[gpu].defer(last_serial(handle), [handle]() {destroy_cmd(handle);});
+  res.deletion_queues[gpu].collect(res.devices[gpu]);
 }
 
 inline auto transition_image(int32_t cmd_id, int32_t image_id, vk::ImageLayout layout) -> void {
@@ -367,10 +631,66 @@ inline auto transition_image(int32_t cmd_id, int32_t image_id, vk::ImageLayout l
 
   LunaAssert(new_layout != vk::ImageLayout::eUndefined, "Attempting to transition an image to an undefined layout, which is not possible");
   cmd.cmd.pipelineBarrier(src, dst, dep_flags, 0, nullptr, 0, nullptr, 1, &image.barrier, gpu.m_dispatch);
+  cmd.images.push_back(image_id);
   image.layout = new_layout;
 }
 
-inline auto copy_buffer_to_buffer(int32_t cmd_id, int32_t from, int32_t to, std::size_t amt = 0) -> void {
+// Hands a buffer over from one queue family to another. Has to be recorded twice: once on the source family's queue
+// to release it, then on the destination's to acquire it.
+inline auto buffer_ownership_barrier(int32_t cmd_id, int32_t buffer_id, unsigned src_family, unsigned dst_family, bool release) -> void {
+  auto& res = global_resources();
+  auto& buffer = res.buffers[buffer_id];
+  auto& cmd = res.cmds[cmd_id];
+  auto& gpu = res.devices[cmd.gpu];
+
+  auto barrier = vk::BufferMemoryBarrier();
+  barrier.setBuffer(buffer.buffer);
+  barrier.setOffset(0);
+  barrier.setSize(VK_WHOLE_SIZE);
+  barrier.setSrcQueueFamilyIndex(src_family);
+  barrier.setDstQueueFamilyIndex(dst_family);
+  if(release) barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+  else barrier.setDstAccessMask(vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+
+  auto src = release ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTransfer) : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+  auto dst = release ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe) : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eAllCommands);
+  cmd.cmd.pipelineBarrier(src, dst, vk::DependencyFlags(), 0, nullptr, 1, &barrier, 0, nullptr, gpu.m_dispatch);
+}
+
+// Same as buffer_ownership_barrier, for images. Keeps the image in whatever layout it's in.
+inline auto image_ownership_barrier(int32_t cmd_id, int32_t image_id, unsigned src_family, unsigned dst_family, bool release) -> void {
+  auto& res = global_resources();
+  auto& image = res.images[image_id];
+  auto& cmd = res.cmds[cmd_id];
+  auto& gpu = res.devices[cmd.gpu];
+
+  auto range = vk::ImageSubresourceRange();
+  range.setBaseArrayLayer(0);
+  range.setBaseMipLevel(0);
+  range.setLevelCount(1);
+  range.setLayerCount(image.info.layers);
+  if (image.format == vk::Format::eD24UnormS8Uint)
+    range.setAspectMask(vk::ImageAspectFlagBits::eDepth | vk::ImageAspectFlagBits::eStencil);
+  else
+    range.setAspectMask(vk::ImageAspectFlagBits::eColor);
+
+  auto barrier = vk::ImageMemoryBarrier();
+  barrier.setImage(image.image);
+  barrier.setOldLayout(image.layout);
+  barrier.setNewLayout(image.layout);
+  barrier.setSubresourceRange(range);
+  barrier.setSrcQueueFamilyIndex(src_family);
+  barrier.setDstQueueFamilyIndex(dst_family);
+  if(release) barrier.setSrcAccessMask(vk::AccessFlagBits::eTransferWrite);
+  else barrier.setDstAccessMask(vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite);
+
+  auto src = release ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTransfer) : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eTopOfPipe);
+  auto dst = release ? vk::PipelineStageFlags(vk::PipelineStageFlagBits::eBottomOfPipe) : vk::PipelineStageFlags(vk::PipelineStageFlagBits::eAllCommands);
+  cmd.cmd.pipelineBarrier(src, dst, vk::DependencyFlags(), 0, nullptr, 0, nullptr, 1, &barrier, gpu.m_dispatch);
+  cmd.images.push_back(image_id);
+}
+
+inline auto copy_buffer_to_buffer(int32_t cmd_id, int32_t from, int32_t to, std::size_t amt = 0, std::size_t src_offset = 0, std::size_t dst_offset = 0) -> void {
   auto& res = global_resources();
   auto& src = res.buffers[from];
   auto& dst = res.buffers[to];
@@ -381,13 +701,13 @@ inline auto copy_buffer_to_buffer(int32_t cmd_id, int32_t from, int32_t to, std:
 
   auto size = amt == 0 ? dst.info.size : amt;
   region.setSize(size);
-  region.setSrcOffset(0);
-  region.setDstOffset(0);
+  region.setSrcOffset(src_offset);
+  region.setDstOffset(dst_offset);
 
   cmd.cmd.copyBuffer(src.buffer, dst.buffer, 1, &region, gpu.m_dispatch);
 }
 
-inline auto copy_buffer_to_image(int32_t cmd_id, int32_t buffer_id, int32_t image_id) -> void {
+inline auto copy_buffer_to_image(int32_t cmd_id, int32_t buffer_id, int32_t image_id, std::size_t buffer_offset = 0) -> void {
   auto& res = global_resources();
   auto& src = res.buffers[buffer_id];
   auto& dst = res.images[image_id];
@@ -402,6 +722,7 @@ inline auto copy_buffer_to_image(int32_t cmd_id, int32_t buffer_id, int32_t imag
   extent.setDepth(1);
 
   info.setImageExtent(extent);
+  info.setBufferOffset(buffer_offset);
   info.setBufferImageHeight(0);
   info.setBufferRowLength(0);
   info.setImageOffset(0);
@@ -414,49 +735,243 @@ inline auto copy_buffer_to_image(int32_t cmd_id, int32_t buffer_id, int32_t imag
     transition_image(cmd_id, image_id, vk::ImageLayout::eTransferDstOptimal);
 
   cmd.cmd.copyBufferToImage(src.buffer, dst.image, vk::ImageLayout::eTransferDstOptimal, 1, &info, gpu.m_dispatch);
+  cmd.images.push_back(image_id);
 
   if (dst_old_layout != vk::ImageLayout::eUndefined)
     transition_image(cmd_id, image_id, dst_old_layout);
 }
 
-inline auto map_buffer(int32_t buffer_id, void** ptr) -> void {
+// Copies an image into a buffer. A row length of zero packs the rows tightly, otherwise it's the pitch in texels.
+inline auto copy_image_to_buffer(int32_t cmd_id, int32_t image_id, int32_t buffer_id, std::size_t buffer_offset = 0, std::size_t row_length = 0) -> void {
+  auto& res = global_resources();
+  auto& src = res.images[image_id];
+  auto& dst = res.buffers[buffer_id];
+  auto& cmd = res.cmds[cmd_id];
+  auto& gpu = res.devices[dst.gpu];
+
+  auto info = vk::BufferImageCopy();
+  auto extent = vk::Extent3D();
+
+  extent.setWidth(src.info.width);
+  extent.setHeight(src.info.height);
+  extent.setDepth(1);
+
+  info.setImageExtent(extent);
+  info.setBufferOffset(buffer_offset);
+  info.setBufferImageHeight(0);
+  info.setBufferRowLength(row_length);
+  info.setImageOffset(0);
+
+  // A copy to a buffer only takes one aspect, and for depth/stencil images depth is the one that's read back.
+  auto layers = src.subresource;
+  if(layers.aspectMask & vk::ImageAspectFlagBits::eDepth) layers.aspectMask = vk::ImageAspectFlagBits::eDepth;
+  info.setImageSubresource(layers);
+
+  auto src_old_layout = src.layout;
+  if (src.layout != vk::ImageLayout::eTransferSrcOptimal)
+    transition_image(cmd_id, image_id, vk::ImageLayout::eTransferSrcOptimal);
+
+  cmd.cmd.copyImageToBuffer(src.image, vk::ImageLayout::eTransferSrcOptimal, dst.buffer, 1, &info, gpu.m_dispatch);
+  cmd.images.push_back(image_id);
+
+  if (src_old_layout != vk::ImageLayout::eUndefined)
+    transition_image(cmd_id, image_id, src_old_layout);
+}
+
+// Copies as much of one image as fits into the other.
+inline auto copy_image_to_image(int32_t cmd_id, int32_t src_id, int32_t dst_id) -> void {
+  auto& res = global_resources();
+  auto& src = res.images[src_id];
+  auto& dst = res.images[dst_id];
+  auto& cmd = res.cmds[cmd_id];
+  auto& gpu = res.devices[cmd.gpu];
+
+  auto info = vk::ImageCopy();
+  auto extent = vk::Extent3D();
+  extent.setWidth(std::min(src.info.width, dst.info.width));
+  extent.setHeight(std::min(src.info.height, dst.info.height));
+  extent.setDepth(1);
+
+  auto src_layers = src.subresource;
+  auto dst_layers = dst.subresource;
+  src_layers.setLayerCount(std::min(src_layers.layerCount, dst_layers.layerCount));
+  dst_layers.setLayerCount(src_layers.layerCount);
+
+  info.setExtent(extent);
+  info.setSrcSubresource(src_layers);
+  info.setDstSubresource(dst_layers);
+
+  auto src_old_layout = src.layout;
+  auto dst_old_layout = dst.layout;
+  if (src.layout != vk::ImageLayout::eTransferSrcOptimal)
+    transition_image(cmd_id, src_id, vk::ImageLayout::eTransferSrcOptimal);
+  if (dst.layout != vk::ImageLayout::eTransferDstOptimal)
+    transition_image(cmd_id, dst_id, vk::ImageLayout::eTransferDstOptimal);
+
+  cmd.cmd.copyImage(src.image, vk::ImageLayout::eTransferSrcOptimal, dst.image, vk::ImageLayout::eTransferDstOptimal, 1, &info, gpu.m_dispatch);
+  cmd.images.push_back(src_id);
+  cmd.images.push_back(dst_id);
+
+  if (src_old_layout != vk::ImageLayout::eUndefined)
+    transition_image(cmd_id, src_id, src_old_layout);
+  if (dst_old_layout != vk::ImageLayout::eUndefined)
+    transition_image(cmd_id, dst_id, dst_old_layout);
+}
+
+// Makes every write before it visible to every access after it. Heavy handed, but never wrong.
+inline auto memory_barrier(int32_t cmd_id, vk::PipelineStageFlags src = vk::PipelineStageFlagBits::eAllCommands, vk::PipelineStageFlags dst = vk::PipelineStageFlagBits::eAllCommands,
+                           vk::AccessFlags dst_access = vk::AccessFlagBits::eMemoryRead | vk::AccessFlagBits::eMemoryWrite) -> void {
+  auto& res = global_resources();
+  auto& cmd = res.cmds[cmd_id];
+  auto& gpu = res.devices[cmd.gpu];
+  auto barrier = vk::MemoryBarrier(vk::AccessFlagBits::eMemoryWrite, dst_access);
+  cmd.cmd.pipelineBarrier(src, dst, vk::DependencyFlags(), 1, &barrier, 0, nullptr, 0, nullptr, gpu.m_dispatch);
+}
+
+// Marks a range of a mapped buffer as written, so the next flush makes it visible to the GPU.
+// Ranges that touch or overlap get merged, so a flush covers exactly what was written.
+inline auto mark_buffer_dirty(int32_t buffer_id, std::size_t offset, std::size_t size) -> void {
+  auto& buffer = global_resources().buffers[buffer_id];
+  if(buffer.coherent || size == 0) return;
+  auto begin = offset;
+  auto end = std::min(offset + size, buffer.size);
+  auto& dirty = buffer.dirty;
+
+  // Find the first range that ends at or after this one begins, then swallow every range this one reaches.
+  auto first = std::lower_bound(dirty.begin(), dirty.end(), begin, [](const auto& range, std::size_t value) {
+    return range.second < value;
+  });
+  auto last = first;
+  while(last != dirty.end() && last->first <= end) {
+    begin = std::min(begin, last->first);
+    end = std::max(end, last->second);
+    ++last;
+  }
+  first = dirty.erase(first, last);
+  dirty.insert(first, {begin, end});
+}
+
+// Flushes a range of a mapped buffer straight away, without touching its dirty range.
+inline auto flush_buffer_range(int32_t buffer_id, std::size_t offset, std::size_t size) -> void {
   auto& res = global_resources();
   auto& buffer = res.buffers[buffer_id];
-  auto alloc = res.allocators[buffer.gpu];
-  vmaMapMemory(alloc, buffer.alloc, ptr);
+  if(buffer.coherent || size == 0) return;
+  vmaFlushAllocation(res.allocators[buffer.gpu], buffer.alloc, offset, size);
 }
 
-inline auto unmap_buffer(int32_t buffer_id) -> void {
+// Flushes whatever has been marked dirty since the last flush, all in one call. Nothing to do for coherent memory.
+inline auto flush_buffer(int32_t buffer_id) -> void {
+  auto& res = global_resources();
+  auto& buffer = res.buffers[buffer_id];
+  if(buffer.coherent || buffer.dirty.empty()) return;
+
+  auto count = buffer.dirty.size();
+  auto allocs = std::vector<VmaAllocation>(count, buffer.alloc);
+  auto offsets = std::vector<VkDeviceSize>(count);
+  auto sizes = std::vector<VkDeviceSize>(count);
+  for(auto index = 0u; index < count; index++) {
+    offsets[index] = buffer.dirty[index].first;
+    sizes[index] = buffer.dirty[index].second - buffer.dirty[index].first;
+  }
+
+  vmaFlushAllocations(res.allocators[buffer.gpu], static_cast<std::uint32_t>(count), allocs.data(), offsets.data(), sizes.data());
+  buffer.dirty.clear();
+}
+
+// Buffers are persistently mapped, so this just hands out the pointer & makes GPU writes visible to the host.
+// Unless the caller tracks what it writes itself, there's no telling, so the whole buffer gets marked dirty.
+inline auto map_buffer(int32_t buffer_id, void** ptr, bool mark_dirty = true) -> void {
   auto& res = global_resources();
   auto& buffer = res.buffers[buffer_id];
-  auto alloc = res.allocators[buffer.gpu];
-  vmaUnmapMemory(alloc, buffer.alloc);
+  LunaAssert(buffer.mapped, "Attempting to map a buffer that is not host visible.");
+  if(!buffer.coherent) {
+    vmaInvalidateAllocation(res.allocators[buffer.gpu], buffer.alloc, 0, VK_WHOLE_SIZE);
+    if(mark_dirty) mark_buffer_dirty(buffer_id, 0, buffer.size);
+  }
+  *ptr = buffer.mapped;
 }
 
-inline auto create_buffer(int gpu, std::size_t size, vk::BufferUsageFlags usage, bool mappable) -> std::int32_t {
+// The mapping itself stays alive until the buffer is destroyed, this only flushes what was written.
+inline auto unmap_buffer(int32_t buffer_id) -> void {
+  flush_buffer(buffer_id);
+}
+
+// Lets memory pressure listeners evict what they can, then waits for it to actually be freed.
+inline auto reclaim_memory(int gpu) -> void {
+  auto& res = global_resources();
+  res.memory_budgets[gpu].out_of_memory(gpu);
+  res.devices[gpu].wait_idle();
+  res.deletion_queues[gpu].collect(res.devices[gpu]);
+}
+
+// Buffers luna makes for itself (like staging memory) are counted as MemoryType::Unknown.
+inline auto create_buffer(int gpu, std::size_t size, vk::BufferUsageFlags usage, HostAccess access, gfx::MemoryType type = gfx::MemoryType::Unknown) -> std::int32_t {
   auto& res  = vulkan::global_resources();
   auto info = vk::BufferCreateInfo();
   auto alloc_info = VmaAllocationCreateInfo{};
-  auto index = luna::vulkan::find_valid_entry(res.buffers);
+  auto index = res.buffers.acquire();
   auto& buffer = res.buffers[index];
   
-  if(mappable) {
-    alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
-    alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT;
-  } else {
-    alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+  switch(access) {
+    case HostAccess::SequentialWrite :
+      alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+      alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      break;
+    case HostAccess::Random :
+      alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+      alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      break;
+    case HostAccess::Streaming :
+      alloc_info.usage = res.devices[gpu].resizable_bar ? VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE : VMA_MEMORY_USAGE_AUTO_PREFER_HOST;
+      alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      break;
+    case HostAccess::DeviceSequentialWrite :
+      // If VRAM the host can see runs out, VMA hands back unmapped memory & writes go through staging instead.
+      alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+      if(!res.devices[gpu].resizable_bar) break;
+      alloc_info.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+      alloc_info.flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT |
+                         VMA_ALLOCATION_CREATE_MAPPED_BIT;
+      break;
+    default :
+      alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+      break;
   }
 
+  // Any buffer can be pointed to from a shader if the device allows it.
+  if(res.devices[gpu].buffer_device_address) usage |= vk::BufferUsageFlagBits::eShaderDeviceAddress;
+
   info.size = size;
   info.usage = usage;
+  alloc_info.pUserData = allocation_tag(index, false);
   buffer.gpu = gpu;
+  buffer.usage = usage;
   auto& c_info = static_cast<VkBufferCreateInfo&>(info);
   auto c_buffer = static_cast<VkBuffer>(buffer.buffer);
-  vmaCreateBuffer(res.allocators[gpu], &c_info, &alloc_info, &c_buffer, &buffer.alloc, nullptr);
+  alloc_info.pool = res.memory_pools[gpu].pool_for(gpu, type, info, alloc_info);
+  auto result = vmaCreateBuffer(res.allocators[gpu], &c_info, &alloc_info, &c_buffer, &buffer.alloc, nullptr);
+  if(result != VK_SUCCESS && alloc_info.pool) {
+    // Pools can be capped & only hold one memory type, so whatever doesn't fit goes to the shared memory instead.
+    alloc_info.pool = nullptr;
+    result = vmaCreateBuffer(res.allocators[gpu], &c_info, &alloc_info, &c_buffer, &buffer.alloc, nullptr);
+  }
+  if(result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+    reclaim_memory(gpu);
+    result = vmaCreateBuffer(res.allocators[gpu], &c_info, &alloc_info, &c_buffer, &buffer.alloc, nullptr);
+  }
+  LunaAssert(result == VK_SUCCESS && c_buffer, "Could not create buffer given input parameters: ", vk::to_string(static_cast<vk::Result>(result)));
   vmaGetAllocationInfo(res.allocators[gpu], buffer.alloc, &buffer.info);
   buffer.buffer = c_buffer;
   buffer.size = size;
-  LunaAssert(c_buffer, "Could not create buffer given input parameters.");
+  buffer.type = type;
+  buffer.mapped = buffer.info.pMappedData;
+  res.memory_budgets[gpu].allocated(type, buffer.info.size);
+
+  if(buffer.mapped) {
+    auto flags = VkMemoryPropertyFlags{};
+    vmaGetAllocationMemoryProperties(res.allocators[gpu], buffer.alloc, &flags);
+    buffer.coherent = (flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) != 0;
+  }
   return index;
 }
 
@@ -465,11 +980,160 @@ inline auto destroy_buffer(std::int32_t handle) -> void {
   auto& buffer = res.buffers[handle];
   auto c_buffer = static_cast<VkBuffer>(buffer.buffer);
   
-  vmaDestroyBuffer(res.allocators[buffer.gpu], c_buffer, buffer.alloc);
+  res.memory_budgets[buffer.gpu].freed(buffer.type, buffer.info.size);
+
+  // If it's mid-move, the defragmenter frees it once the copies out of it are done.
+  if(!res.defragmenters[buffer.gpu].abandon(handle, false)) vmaDestroyBuffer(res.allocators[buffer.gpu], c_buffer, buffer.alloc);
+  res.memory_pools[buffer.gpu].collect(buffer.gpu);
   buffer.info = {};
+  buffer.type = gfx::MemoryType::Unknown;
+  buffer.usage = {};
   buffer.buffer = nullptr;
   buffer.size = 0;
   buffer.alloc = nullptr;
+  buffer.mapped = nullptr;
+  buffer.coherent = true;
+  buffer.address = 0;
+  buffer.dirty.clear();
+  res.buffers.release(handle);
+}
+
+// The buffer's address on the GPU. Once taken, the defragmenter won't move the buffer.
+inline auto buffer_device_address(std::int32_t handle) -> vk::DeviceAddress {
+  auto& res = global_resources();
+  auto& buffer = res.buffers[handle];
+  auto& device = res.devices[buffer.gpu];
+  LunaAssert(device.buffer_device_address, "Device does not support buffer device addresses.");
+  if(!buffer.address) buffer.address = device.gpu.getBufferAddress(vk::BufferDeviceAddressInfo(buffer.buffer), device.m_dispatch);
+  return buffer.address;
+}
+
+// Records into the calling thread's staging command buffer, then submits it and waits for it to finish.
+// Returns the submission's serial.
+template<typename Func>
+inline auto record_staged(int gpu, Func&& record) -> std::uint64_t {
+  auto& res = global_resources();
+  auto cmd = res.staging_pools[gpu].command_buffer(gpu);
+  begin_command_buffer(cmd);
+  record(cmd);
+  end_command_buffer(cmd);
+  submit_command_buffer(cmd);
+  auto serial = res.cmds[cmd].serial;
+  synchronize_cmd(cmd);
+  return serial;
+}
+
+// Copies host data into a buffer that isn't host visible, through the gpu's staging pool.
+inline auto upload_staged(int32_t buffer_id, const unsigned char* data, std::size_t size, std::size_t dst_offset = 0) -> void {
+  if(size == 0) return;
+  auto& res = global_resources();
+  auto gpu = res.buffers[buffer_id].gpu;
+  auto& pool = res.staging_pools[gpu];
+  auto staging = pool.allocate(gpu, size);
+  gfx::stream_copy(staging.data, data, size);
+  flush_buffer_range(staging.buffer, staging.offset, size);
+
+  auto serial = record_staged(gpu, [&](int32_t cmd) {
+    copy_buffer_to_buffer(cmd, staging.buffer, buffer_id, size, staging.offset, dst_offset);
+  });
+  pool.release(staging, serial);
+}
+
+// Copies host data into an image, through the gpu's staging pool.
+inline auto upload_image_staged(int32_t image_id, const unsigned char* data, std::size_t size) -> void {
+  auto& res = global_resources();
+  auto gpu = res.images[image_id].info.gpu;
+  auto& pool = res.staging_pools[gpu];
+  auto staging = pool.allocate(gpu, size);
+  gfx::stream_copy(staging.data, data, size);
+  flush_buffer_range(staging.buffer, staging.offset, size);
+
+  auto serial = record_staged(gpu, [&](int32_t cmd) {
+    copy_buffer_to_image(cmd, staging.buffer, image_id, staging.offset);
+  });
+  pool.release(staging, serial);
+}
+
+#if defined(VK_EXT_host_image_copy)
+// Whether images made like this can be written straight from host memory, and the device says it accesses them just
+// as well afterwards (host copies can cost an image its compression). Attachments are left to the GPU regardless.
+inline auto supports_host_copy(Device& device, const vk::ImageCreateInfo& info) -> bool {
+  using Usage = vk::ImageUsageFlagBits;
+  if(!device.host_image_copy) return false;
+  if(info.usage & (Usage::eColorAttachment | Usage::eDepthStencilAttachment)) return false;
+  auto props = device.physical_device.getFormatProperties2<vk::FormatProperties2, vk::FormatProperties3>(info.format, device.m_dispatch);
+  if(!(props.get<vk::FormatProperties3>().optimalTilingFeatures & vk::FormatFeatureFlagBits2::eHostImageTransferEXT)) return false;
+
+  auto format_info = vk::PhysicalDeviceImageFormatInfo2();
+  format_info.setFormat(info.format);
+  format_info.setType(info.imageType);
+  format_info.setTiling(vk::ImageTiling::eOptimal);
+  format_info.setUsage(info.usage | Usage::eHostTransferEXT);
+  format_info.setFlags(info.flags);
+
+  // Combinations the device can't make at all come back as an error, which just means no.
+  auto query = device.physical_device.getImageFormatProperties2<vk::ImageFormatProperties2, vk::HostImageCopyDevicePerformanceQueryEXT>(format_info, device.m_dispatch);
+  if(query.result != vk::Result::eSuccess) return false;
+  return query.value.get<vk::HostImageCopyDevicePerformanceQueryEXT>().optimalDeviceAccess;
+}
+
+// Moves an image into a new layout on the host, without a command buffer. Only for images the GPU isn't using.
+inline auto host_transition_image(int32_t image_id, vk::ImageLayout layout) -> void {
+  auto& res = global_resources();
+  auto& image = res.images[image_id];
+  auto& gpu = res.devices[image.info.gpu];
+
+  auto range = vk::ImageSubresourceRange();
+  range.setBaseArrayLayer(0);
+  range.setBaseMipLevel(0);
+  range.setLevelCount(1);
+  range.setLayerCount(image.info.layers);
+  range.setAspectMask(vk::ImageAspectFlagBits::eColor);
+
+  auto info = vk::HostImageLayoutTransitionInfoEXT();
+  info.setImage(image.image);
+  info.setOldLayout(image.layout);
+  info.setNewLayout(layout);
+  info.setSubresourceRange(range);
+  error(gpu.gpu.transitionImageLayoutEXT(1, &info, gpu.m_dispatch));
+  image.layout = layout;
+}
+
+// Writes host data straight into an image, in whatever layout it's in.
+inline auto copy_memory_to_image(int32_t image_id, const unsigned char* data) -> void {
+  auto& res = global_resources();
+  auto& image = res.images[image_id];
+  auto& gpu = res.devices[image.info.gpu];
+
+  auto region = vk::MemoryToImageCopyEXT();
+  region.setPHostPointer(data);
+  region.setImageSubresource(image.subresource);
+  region.setImageExtent(vk::Extent3D{static_cast<unsigned>(image.info.width), static_cast<unsigned>(image.info.height), 1});
+
+  auto info = vk::CopyMemoryToImageInfoEXT();
+  info.setDstImage(image.image);
+  info.setDstImageLayout(image.layout);
+  info.setRegionCount(1);
+  info.setPRegions(&region);
+  error(gpu.gpu.copyMemoryToImageEXT(&info, gpu.m_dispatch));
+}
+#endif
+
+// Copies host data into an image. Straight from host memory when the image allows it, otherwise through staging.
+// That copy happens right away, so unless `in_use` is false it first waits for submitted work using the image to finish.
+inline auto upload_image(int32_t image_id, const unsigned char* data, std::size_t size, bool in_use = true) -> void {
+#if defined(VK_EXT_host_image_copy)
+  auto& res = global_resources();
+  auto& image = res.images[image_id];
+  if(image.usage & vk::ImageUsageFlagBits::eHostTransferEXT && image.layout == vk::ImageLayout::eGeneral) {
+    auto gpu = image.info.gpu;
+    auto last_use = image.last_use.load();
+    if(in_use && last_use) res.deletion_queues[gpu].wait(res.devices[gpu], last_use);
+    copy_memory_to_image(image_id, data);
+    return;
+  }
+#endif
+  upload_image_staged(image_id, data, size);
 }
 
 inline auto standard_image_usage() {
@@ -534,7 +1198,7 @@ inline auto create_image_view(luna::vulkan::Device& device, luna::vulkan::Image&
 
 inline auto create_image(gfx::ImageInfo& in_info, vk::ImageLayout layout, vk::ImageUsageFlags usage, vk::Image import) -> int32_t {
   auto& res = luna::vulkan::global_resources();
-  auto index = luna::vulkan::find_valid_entry(res.images);
+  auto index = res.images.acquire();
   auto& gpu = res.devices[in_info.gpu];
   auto& image = res.images[index];
   image.info = in_info;
@@ -579,7 +1243,7 @@ inline auto create_image(gfx::ImageInfo& in_info, vk::ImageLayout layout, vk::Im
   auto& gpu = res.devices[in_info.gpu];
   auto info = vk::ImageCreateInfo();
   auto alloc_info = VmaAllocationCreateInfo{};
-  auto index = luna::vulkan::find_valid_entry(res.images);
+  auto index = res.images.acquire();
   auto& image = res.images[index];
   
   if (in_info.is_cubemap) {
@@ -608,18 +1272,34 @@ inline auto create_image(gfx::ImageInfo& in_info, vk::ImageLayout layout, vk::Im
   info.initialLayout = vk::ImageLayout::eUndefined;
   info.mipLevels = in_info.num_mips;
   info.usage = usage;
+#if defined(VK_EXT_host_image_copy)
+  // Textures get uploaded straight from host memory when that's no worse for the GPU sampling them.
+  if(usage & vk::ImageUsageFlagBits::eSampled && supports_host_copy(gpu, info)) {
+    usage |= vk::ImageUsageFlagBits::eHostTransferEXT;
+    info.usage = usage;
+  }
+#endif
   info.samples = sample_count(in_info.msaa_samples, gpu.properties);
   alloc_info.usage = VMA_MEMORY_USAGE_AUTO;
+  alloc_info.pUserData = allocation_tag(index, true);
 
   image.subresource.setAspectMask(vk::ImageAspectFlagBits::eColor);
   image.subresource.setBaseArrayLayer(0);
   image.subresource.setLayerCount(in_info.layers);
   image.subresource.setMipLevel(0);
+  image.create_info = info;
 
   auto& c_info = static_cast<VkImageCreateInfo&>(info); 
   auto c_image = static_cast<VkImage>(image.image);
-  vmaCreateImage(allocator, &c_info, &alloc_info, &c_image, &image.alloc, nullptr);
-  LunaAssert(c_image, "Could not create image given input parameters.");
+  auto result = vmaCreateImage(allocator, &c_info, &alloc_info, &c_image, &image.alloc, nullptr);
+  if(result == VK_ERROR_OUT_OF_DEVICE_MEMORY || result == VK_ERROR_OUT_OF_HOST_MEMORY) {
+    reclaim_memory(in_info.gpu);
+    result = vmaCreateImage(allocator, &c_info, &alloc_info, &c_image, &image.alloc, nullptr);
+  }
+  LunaAssert(result == VK_SUCCESS && c_image, "Could not create image given input parameters: ", vk::to_string(static_cast<vk::Result>(result)));
+  auto vma_info = VmaAllocationInfo();
+  vmaGetAllocationInfo(allocator, image.alloc, &vma_info);
+  res.memory_budgets[in_info.gpu].allocated_image(vma_info.size);
   image.info = in_info;
   image.image = c_image;
   image.layout = layout;
@@ -629,13 +1309,15 @@ inline auto create_image(gfx::ImageInfo& in_info, vk::ImageLayout layout, vk::Im
   create_image_view(gpu, image);
   
   // Transition image to general format.
-  auto cmd = luna::vulkan::create_cmd(in_info.gpu);
-  luna::vulkan::begin_command_buffer(cmd);
-  luna::vulkan::transition_image(cmd, index, vk::ImageLayout::eGeneral);
-  luna::vulkan::end_command_buffer(cmd);
-  luna::vulkan::submit_command_buffer(cmd);
-  luna::vulkan::synchronize_cmd(cmd);
-  luna::vulkan::destroy_cmd(cmd);
+#if defined(VK_EXT_host_image_copy)
+  if(usage & vk::ImageUsageFlagBits::eHostTransferEXT) {
+    host_transition_image(index, vk::ImageLayout::eGeneral);
+    return index;
+  }
+#endif
+  record_staged(in_info.gpu, [&](int32_t cmd) {
+    luna::vulkan::transition_image(cmd, index, vk::ImageLayout::eGeneral);
+  });
   return index;
 }
 
@@ -643,27 +1325,41 @@ inline auto destroy_image(int32_t handle) -> void {
   auto& res  = luna::vulkan::global_resources();
   auto& img = res.images[handle];
   auto& gpu = res.devices[img.info.gpu];
-  if(!img.valid()) return;
+  if(!img.valid()) {
+    res.images.release(handle);
+    return;
+  }
   if(img.imported) {
     img.imported = false;
     gpu.gpu.destroy(img.view, gpu.allocate_cb, gpu.m_dispatch);
     gpu.gpu.destroy(img.sampler, gpu.allocate_cb, gpu.m_dispatch);
   } else {
     auto c_img = static_cast<VkImage>(img.image);
-    gpu.gpu.destroy(img.view, gpu.allocate_cb, gpu.m_dispatch);
+    auto vma_info = VmaAllocationInfo();
+    vmaGetAllocationInfo(res.allocators[img.info.gpu], img.alloc, &vma_info);
+    res.memory_budgets[img.info.gpu].freed_image(vma_info.size);
     gpu.gpu.destroy(img.sampler, gpu.allocate_cb, gpu.m_dispatch);
-    vmaDestroyImage(res.allocators[img.info.gpu], c_img, img.alloc);
+
+    // If it's mid-move, the defragmenter frees it & its view once the copies out of it are done.
+    if(!res.defragmenters[img.info.gpu].abandon(handle, true)) {
+      gpu.gpu.destroy(img.view, gpu.allocate_cb, gpu.m_dispatch);
+      vmaDestroyImage(res.allocators[img.info.gpu], c_img, img.alloc);
+    }
     img.alloc = nullptr;
   }
   img.view = nullptr;
   img.sampler = nullptr;
   img.image = nullptr;
+  img.create_info = vk::ImageCreateInfo();
+  img.attachment = false;
+  img.last_use = 0;
+  res.images.release(handle);
 }
 
 inline auto create_graphics_pipeline(int32_t rp_handle, gfx::GraphicsPipelineInfo info) -> int32_t {
   auto& res = global_resources();
   auto& rp = res.render_passes[rp_handle];
-  auto index = find_valid_entry(res.pipelines);
+  auto index = res.pipelines.acquire();
   auto& pipe = res.pipelines[index];
   
   pipe = std::move(Pipeline(rp, info));
@@ -672,7 +1368,7 @@ inline auto create_graphics_pipeline(int32_t rp_handle, gfx::GraphicsPipelineInf
 
 inline auto create_compute_pipeline(gfx::ComputePipelineInfo info) -> int32_t {
   auto& res = global_resources();
-  auto index = find_valid_entry(res.pipelines);
+  auto index = res.pipelines.acquire();
   auto& pipe = res.pipelines[index];
   
   pipe = std::move(Pipeline(info));
@@ -680,7 +1376,11 @@ inline auto create_compute_pipeline(gfx::ComputePipelineInfo info) -> int32_t {
 }
 
 inline auto destroy_pipeline(int32_t handle) -> void {
-  auto tmp = std::move(global_resources().pipelines[handle]);
+  auto& res = global_resources();
+  {
+    auto tmp = std::move(res.pipelines[handle]);
+  }
+  res.pipelines.release(handle);
 }
 
 inline auto create_bind_group(int32_t pipe_handle) -> int32_t {
@@ -277,10 +277,12 @@ auto draw_loop() -> void {
   auto transform = data->transforms.get_mapped_container();
 
   transform[0].model = mat4(1.0f);
+  transform.flush();
   data->projection = luna::perspective(luna::to_radians(90.f), static_cast<float>(data->window.width()) / static_cast<float>(data->window.height()), 0.1f, 1000.f);
   while(running) {
     auto info = data->camera.info();
     camera[0].view_matrix = data->projection * info.view_matrix;
+    camera.flush();
     // Combo next gpu action to the cmd list.
     data->window.combo_into(*cmd);
     data->window.acquire();
@@ -302,7 +304,7 @@ auto draw_loop() -> void {
     cmd->end();
 
     cmd->combo_into(data->window);
-    auto fence = cmd->submit();
+    cmd->enqueue();
     data->window.present();
 
     cmd.advance();
@@ -0,0 +1,204 @@
+#include "luna-gfx/gfx.hpp"
+#include "luna-gfx/ext/ext.hpp"
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#include "parallel_vert.hpp"
+#include "parallel_frag.hpp"
+
+struct DrawConstants {
+  float offset_scale[4];
+  float color[4];
+};
+
+static_assert(sizeof(DrawConstants) == (sizeof(float) * 8));
+
+constexpr auto cGPU = 0;
+constexpr auto cGridWidth = 250u;
+constexpr auto cGridHeight = 200u;
+constexpr auto cNumDraws = cGridWidth * cGridHeight;
+
+const std::vector<luna::vec3> cVertices = {
+  {-1.0f, -1.0f, 0.0f},
+  { 1.0f, -1.0f, 0.0f},
+  { 0.0f,  1.0f, 0.0f},
+};
+
+luna::gfx::Window window;
+luna::gfx::Renderer renderer;
+luna::gfx::BindGroup bind_group;
+luna::gfx::Vector<luna::vec3> vertices;
+
+bool running = true;
+
+namespace luna {
+/** Records a slice of the frame's draws on each of a few long lived threads.
+ * Each worker keeps one secondary list per primary the renderer cycles through, made on that worker so it's recorded
+ * out of the worker's own command pool.
+ */
+class Workers {
+  public:
+    explicit Workers(unsigned count) {
+      this->m_lists.resize(count);
+      for(auto index = 0u; index < count; index++) this->m_threads.emplace_back([this, index, count]() {this->run(index, count);});
+    }
+
+    ~Workers() {
+      {
+        auto lock = std::unique_lock(this->m_lock);
+        this->m_quit = true;
+      }
+      this->m_start.notify_all();
+      for(auto& thread : this->m_threads) thread.join();
+    }
+
+    // Records every draw into secondaries of `cmd`, returning once all of them are ended.
+    auto record(gfx::CommandList& cmd, float time) -> std::vector<gfx::CommandList*> {
+      {
+        auto lock = std::unique_lock(this->m_lock);
+        this->m_cmd = &cmd;
+        this->m_time = time;
+        this->m_remaining = this->m_threads.size();
+        this->m_frame++;
+      }
+      this->m_start.notify_all();
+
+      auto lock = std::unique_lock(this->m_lock);
+      this->m_done.wait(lock, [this]() {return this->m_remaining == 0;});
+      auto out = std::vector<gfx::CommandList*>();
+      for(auto& lists : this->m_lists) out.push_back(&lists[cmd.handle()]);
+      return out;
+    }
+
+  private:
+    std::vector<std::thread> m_threads;
+    std::vector<std::map<std::int32_t, gfx::CommandList>> m_lists;
+    std::mutex m_lock;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    gfx::CommandList* m_cmd = nullptr;
+    float m_time = 0.0f;
+    std::size_t m_remaining = 0;
+    std::size_t m_frame = 0;
+    bool m_quit = false;
+
+    auto run(unsigned index, unsigned count) -> void {
+      auto seen = std::size_t(0);
+      while(true) {
+        gfx::CommandList* cmd = nullptr;
+        auto time = 0.0f;
+        {
+          auto lock = std::unique_lock(this->m_lock);
+          this->m_start.wait(lock, [&]() {return this->m_quit || this->m_frame != seen;});
+          if(this->m_quit) return;
+          seen = this->m_frame;
+          cmd = this->m_cmd;
+          time = this->m_time;
+        }
+
+        auto& list = this->m_lists[index][cmd->handle()];
+        if(list.handle() < 0) list = gfx::CommandList(cGPU, *cmd);
+        this->draw(list, index, count, time);
+
+        auto lock = std::unique_lock(this->m_lock);
+        if(--this->m_remaining == 0) this->m_done.notify_one();
+      }
+    }
+
+    auto draw(gfx::CommandList& list, unsigned index, unsigned count, float time) -> void {
+      constexpr auto cCellWidth = 2.0f / static_cast<float>(cGridWidth);
+      constexpr auto cCellHeight = 2.0f / static_cast<float>(cGridHeight);
+      auto per_thread = (cNumDraws + count - 1) / count;
+      auto first = index * per_thread;
+      auto last = std::min(cNumDraws, first + per_thread);
+
+      list.begin();
+      list.bind(bind_group);
+      list.viewport({static_cast<float>(window.width()), static_cast<float>(window.height())});
+      for(auto draw = first; draw < last; draw++) {
+        auto x = static_cast<float>(draw % cGridWidth);
+        auto y = static_cast<float>(draw / cGridWidth);
+        auto wave = 0.5f + 0.5f * std::sin(time + x * 0.1f + y * 0.1f);
+        auto constants = DrawConstants{{-1.0f + (x + 0.5f) * cCellWidth, -1.0f + (y + 0.5f) * cCellHeight, cCellWidth * 0.4f * wave, cCellHeight * 0.4f * wave},
+                                       {x / cGridWidth, y / cGridHeight, wave, 1.0f}};
+        list.push_constants(constants);
+        list.draw(vertices);
+      }
+      list.end();
+    }
+};
+
+auto init_graphics_pipeline() -> void {
+  auto vert_shader = std::vector<uint32_t>(parallel_vert, std::end(parallel_vert));
+  auto frag_shader = std::vector<uint32_t>(parallel_frag, std::end(parallel_frag));
+
+  auto info = gfx::RendererInfo();
+  info.render_pass_info = {cGPU, window.width(), window.height(), {{"Default", {{"WindowOutput", window.image_views()}}}}};
+  info.pipeline_infos["ParallelPipeline"] = {cGPU, {{"vertex", luna::gfx::ShaderType::Vertex, vert_shader}, {"fragment", luna::gfx::ShaderType::Fragment, frag_shader}}};
+  renderer = std::move(gfx::Renderer(info));
+  bind_group = renderer.pipeline("ParallelPipeline").create_bind_group();
+  vertices = gfx::Vector<vec3>(cGPU, cVertices.size());
+  vertices.upload(cVertices.data());
+}
+
+auto draw_loop() -> void {
+  auto workers = Workers(std::max(2u, std::thread::hardware_concurrency()) - 1);
+  auto event_handler = gfx::EventRegister();
+  event_handler.add([](const gfx::Event& event) {if(event.type() == gfx::Event::Type::WindowExit) running = false;});
+
+  auto start_time = std::chrono::system_clock::now();
+  auto last_report = start_time;
+  auto frames = 0u;
+  auto record_time = std::chrono::duration<double, std::milli>(0);
+  while(running) {
+    auto& cmd = renderer.next();
+    auto time = std::chrono::duration<float>(std::chrono::system_clock::now() - start_time).count();
+
+    window.combo_into(cmd);
+    window.acquire();
+
+    // The pass is started inline, but everything drawn in it comes from the workers' secondaries.
+    auto record_start = std::chrono::system_clock::now();
+    cmd.begin();
+    cmd.start_draw(renderer.pass(), window.current_frame(), true);
+    cmd.execute(workers.record(cmd, time));
+    cmd.end_draw();
+    cmd.end();
+    record_time += std::chrono::system_clock::now() - record_start;
+
+    // No waiting here: the renderer only waits on a frame's work when its list comes back around, and each worker's
+    // secondaries are kept per list, so they're only reused once that same frame is done.
+    cmd.combo_into(window);
+    cmd.enqueue();
+    window.present();
+    luna::gfx::poll_events();
+
+    frames++;
+    auto now = std::chrono::system_clock::now();
+    if(now - last_report > std::chrono::seconds(1)) {
+      std::cout << cNumDraws << " draws | " << frames << " fps | " << record_time.count() / frames << "ms recording per frame" << std::endl;
+      last_report = now;
+      frames = 0;
+      record_time = {};
+    }
+  }
+
+  // Before we deconstruct everything, make sure we're done working on the GPU.
+  gfx::synchronize_gpu(cGPU);
+}
+}
+
+auto main(int argc, const char* argv[]) -> int {
+  window = luna::gfx::Window(luna::gfx::WindowInfo());
+  luna::init_graphics_pipeline();
+  luna::draw_loop();
+  return 0;
+}
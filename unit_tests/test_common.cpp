@@ -1,8 +1,13 @@
 #include <gtest/gtest.h>
 #include "luna-gfx/common/dlloader.hpp"
 #include "luna-gfx/common/shader.hpp"
+#include "luna-gfx/common/slot_map.hpp"
+#include "luna-gfx/common/streaming_copy.hpp"
+#include <algorithm>
 #include <utility>
 #include <memory>
+#include <thread>
+#include <vector>
 namespace luna::common_test {
 TEST(CommonLibrary, DlloaderTest)
 {
@@ -18,6 +23,120 @@ TEST(CommonLibrary, DlloaderTest)
   auto symbol = loader.symbol(cSymbolName);
   EXPECT_TRUE(symbol);
 }
+
+TEST(CommonLibrary, StreamCopyTest)
+{
+  constexpr auto cSize = 64u * 1024u + 37u;
+  constexpr auto cOffset = 5u; // Misaligned on purpose, so the unaligned head & tail get copied too.
+  auto src = std::vector<unsigned char>(cSize);
+  for(auto i = 0u; i < cSize; i++) src[i] = static_cast<unsigned char>(i * 31u);
+
+  for(auto kernel : {luna::gfx::CopyKernel::Scalar, luna::gfx::CopyKernel::SSE2, luna::gfx::CopyKernel::AVX2}) {
+    auto dst = std::vector<unsigned char>(cSize + 2 * cOffset, 0);
+    luna::gfx::stream_copy(kernel, dst.data() + cOffset, src.data(), cSize);
+    EXPECT_TRUE(std::equal(src.begin(), src.end(), dst.begin() + cOffset));
+    EXPECT_EQ(dst[cOffset - 1], 0);
+    EXPECT_EQ(dst[cOffset + cSize], 0);
+  }
+}
+
+TEST(CommonLibrary, SlotMapTest)
+{
+  constexpr auto cCapacity = 4u;
+  auto map = luna::gfx::SlotMap<int>(cCapacity);
+  auto first = map.acquire();
+  auto second = map.acquire();
+  EXPECT_GE(first, 0);
+  EXPECT_GE(second, 0);
+  EXPECT_NE(first, second);
+  EXPECT_EQ(map.size(), 2u);
+
+  map[first] = 1337;
+  EXPECT_EQ(map[first], 1337);
+
+  // Releasing recycles the slot, but the old handle must not alias the new occupant.
+  map.release(first);
+  auto recycled = map.acquire();
+  EXPECT_EQ(luna::gfx::SlotMap<int>::index_of(recycled), luna::gfx::SlotMap<int>::index_of(first));
+  EXPECT_NE(recycled, first);
+  EXPECT_FALSE(map.valid(first));
+  EXPECT_TRUE(map.valid(recycled));
+  EXPECT_FALSE(map.valid(-1));
+
+  auto count = 0u;
+  map.for_each([&count](std::int32_t, int&) {count++;});
+  EXPECT_EQ(count, map.size());
+}
+
+TEST(CommonLibrary, SlotMapGrowthTest)
+{
+  constexpr auto cChunkSize = 8u;
+  constexpr auto cNumObjects = 1000u;
+  auto map = luna::gfx::SlotMap<int, cChunkSize, 1024>();
+
+  // Nothing is allocated until the first acquire.
+  EXPECT_EQ(map.capacity(), 0u);
+  EXPECT_EQ(map.memory_usage(), 0u);
+
+  auto first = map.acquire();
+  map[first] = 1337;
+  auto* address = &map[first];
+  EXPECT_EQ(map.capacity(), cChunkSize);
+
+  // Growing well past the first chunk must not move anything that's already been handed out.
+  for(auto i = 1u; i < cNumObjects; i++) map[map.acquire()] = static_cast<int>(i);
+  EXPECT_EQ(map.size(), cNumObjects);
+  EXPECT_GE(map.capacity(), cNumObjects);
+  EXPECT_EQ(&map[first], address);
+  EXPECT_EQ(map[first], 1337);
+}
+
+TEST(CommonLibrary, SlotMapThreadTest)
+{
+  constexpr auto cNumThreads = 16u;
+  constexpr auto cNumIterations = 10000u;
+  constexpr auto cChunkSize = 16u;
+  auto map = luna::gfx::SlotMap<std::uint32_t, cChunkSize>();
+  auto threads = std::vector<std::thread>();
+
+  // Every thread keeps a few handles alive at once so the map has to grow while others are reading.
+  for(auto t = 0u; t < cNumThreads; t++) {
+    threads.emplace_back([&map, t]() {
+      auto held = std::vector<std::int32_t>();
+      for(auto i = 0u; i < cNumIterations; i++) {
+        auto handle = map.acquire();
+        map[handle] = t;
+        held.push_back(handle);
+        if(held.size() == cChunkSize) {
+          for(auto h : held) {
+            EXPECT_EQ(map[h], t);
+            map.release(h);
+          }
+          held.clear();
+        }
+      }
+      for(auto h : held) map.release(h);
+    });
+  }
+
+  // Lookups don't lock, so keep checking a handle while the slots around it are recycled.
+  auto kept = map.acquire();
+  map[kept] = cNumThreads;
+  auto checker = std::thread([&map, kept]() {
+    for(auto i = 0u; i < cNumIterations; i++) {
+      EXPECT_TRUE(map.valid(kept));
+      EXPECT_EQ(map[kept], cNumThreads);
+      auto live = 0u;
+      map.for_each([&live](std::int32_t, std::uint32_t&) {live++;});
+      EXPECT_GE(live, 1u);
+    }
+  });
+
+  for(auto& thread : threads) thread.join();
+  checker.join();
+  map.release(kept);
+  EXPECT_TRUE(map.empty());
+}
 }
 int main(int argc, char** argv)
 {
@@ -0,0 +1,8 @@
+#version 450 core
+layout (location = 0) in vec4 frag_color;
+layout (location = 0) out vec4 FragColor;
+
+void main()
+{
+  FragColor = frag_color;
+}
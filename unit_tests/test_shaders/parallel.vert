@@ -0,0 +1,16 @@
+#version 450 core
+#extension GL_ARB_separate_shader_objects : enable
+layout (location = 0) in vec3 aPos;
+layout (location = 0) out vec4 frag_color;
+
+// Everything per-draw comes in through push constants, so recording a draw touches no descriptors.
+layout (push_constant) uniform Draw {
+  vec4 offset_scale;
+  vec4 color;
+} draw;
+
+void main()
+{
+  gl_Position = vec4(aPos.xy * draw.offset_scale.zw + draw.offset_scale.xy, aPos.z, 1.0);
+  frag_color = draw.color;
+}